@@ -8,6 +8,7 @@
 
 #include "globals.h"
 #include "symtab.h"
+#include "util.h"
 #include "analyze.h"
 
 #define MAX_SCOPE 1000
@@ -101,26 +102,29 @@ static int getLocation(int size)
 /* Procedure traverse is a generic recursive 
  * syntax tree traversal routine:
  * it applies preProc in preorder and postProc 
- * in postorder to tree pointed to by t
+ * in postorder to tree pointed to by t.
+ * It recurses on children only, and loops over
+ * siblings, so its depth is the nesting depth.
  */
 static void traverse( TreeNode * t,
                void (* preProc) (TreeNode *),
                void (* postProc) (TreeNode *) )
 {
-    if (t != NULL)
+    int i;
+
+    while (t != NULL)
     {
         preProc(t);
 
         /* traverse through children. */
-        int i;
         for (i=0; i < MAXCHILDREN; i++)
         {
-            traverse(t->child[i],preProc,postProc);
+            traverse(NODE(t->child[i]),preProc,postProc);
         }
         
         postProc(t);
 
-        traverse(t->sibling,preProc,postProc);
+        t = NODE(t->sibling);
     }
 }
 
@@ -133,7 +137,7 @@ static void backtrackProc(TreeNode * t)
     {
         currentTable = currentTable->parent;
     }
-    else if (t->nodekind == DeclareK && t->child[1] != NULL)
+    else if (t->nodekind == DeclareK && NODE(t->child[1]) != NULL)
     {
         /* function declaration ended : pop location stack */
         popLocation();
@@ -146,14 +150,14 @@ static void forwardProc(TreeNode * t)
 {
     if (t->nodekind == DeclareK
             && t->kind.declaration == IdDec
-            && t->child[1] != NULL
-            && t->child[1]->nodekind == StmtK)
+            && NODE(t->child[1]) != NULL
+            && NODE(t->child[1])->nodekind == StmtK)
     {
         currentTable = currentTable->child;
 
         /* find the following function name from siblings. */
         while (currentTable != NULL
-                && strcmp(currentTable->functionName, t->attr.name) != 0)
+                && currentTable->functionName != NAME(t))
         {
             currentTable = currentTable->sibling;
         }
@@ -187,7 +191,7 @@ static void forwardProc(TreeNode * t)
 static int paramCheck(BucketList lookupResult, TreeNode *t)
 {
     lookupResult = lookupResult->param;
-    t = t->child[0];
+    t = NODE(t->child[0]);
 
     while (lookupResult != NULL || t != NULL)
     {
@@ -204,7 +208,7 @@ static int paramCheck(BucketList lookupResult, TreeNode *t)
         }
 
         lookupResult = lookupResult->param;
-        t = t->sibling;
+        t = NODE(t->sibling);
     }
 
     return 1;
@@ -224,7 +228,7 @@ static void insertNode( TreeNode * t)
             int isFunction;
 
             /* figure out this is function or variable */
-            if (t->child[1] != NULL && t->child[1]->nodekind == StmtK)
+            if (NODE(t->child[1]) != NULL && NODE(t->child[1])->nodekind == StmtK)
             {
                 isFunction = 1;
 
@@ -236,16 +240,14 @@ static void insertNode( TreeNode * t)
                                0 /* not parameter */ ) == -1)
                 {
                     /* error : duplicated insertion */
-                    duplicateError(t, t->attr.name);
+                    duplicateError(t, NAME(t));
                 }
 
                 /* create and initialize new table. */
                 struct SymbolTable *newTable
-                    = (struct SymbolTable *)malloc(sizeof(struct SymbolTable));
+                    = (struct SymbolTable *)calloc(1, sizeof(struct SymbolTable));
             
-                strncpy( newTable->functionName, 
-                         t->attr.name, 
-                         strlen(t->attr.name) + 1);
+                newTable->functionName = NAME(t);
                 newTable->depth = currentTable->depth + 1;
                 newTable->child = NULL;
                 newTable->sibling = NULL;
@@ -288,7 +290,7 @@ static void insertNode( TreeNode * t)
                 int size = 1;
                 if (t->type == IntegerArray)
                 {
-                    size = t->child[0]->attr.val;
+                    size = NODE(t->child[0])->attr.val;
                 }
 
                 if (st_insert( currentTable->hashTable,
@@ -299,7 +301,7 @@ static void insertNode( TreeNode * t)
                                0 /* not parameter */ ) == -1)
                 {
                     /* error : duplicated insertion */
-                    duplicateError(t, t->attr.name);
+                    duplicateError(t, NAME(t));
                 }
             }
         }
@@ -313,7 +315,7 @@ static void insertNode( TreeNode * t)
                            1 /* parameter */ ) == -1)
             {
                 /* error : duplicated insertion */
-                duplicateError(t, t->attr.name);
+                duplicateError(t, NAME(t));
             }
 
             /* add param to function. */
@@ -326,7 +328,7 @@ static void insertNode( TreeNode * t)
                 }
 
                 node->param = (BucketList)malloc(sizeof(*node));
-                node->param->name = t->attr.name;
+                node->param->name = NAME(t);
                 node->param->type = t->type;
                 node->param->param = NULL;
                 node->param->lineno = t->lineno;
@@ -353,9 +355,9 @@ static void insertNode( TreeNode * t)
                 break;
 
             case IdExp:
-                if ((lookupResult = st_lookup( currentTable, t->attr.name )) != NULL)
+                if ((lookupResult = st_lookup( currentTable, NAME(t) )) != NULL)
                 {
-                    if (lookupResult->type == IntegerArray && t->child[0] != NULL)
+                    if (lookupResult->type == IntegerArray && NODE(t->child[0]) != NULL)
                     {
                         t->type = Integer;
                     }
@@ -368,11 +370,11 @@ static void insertNode( TreeNode * t)
                 {
                     if (t->type == Func)
                     {
-                        undeclaredFunctionError(t, t->attr.name);
+                        undeclaredFunctionError(t, NAME(t));
                     }
                     else
                     {
-                        undeclaredVariableError(t, t->attr.name);
+                        undeclaredVariableError(t, NAME(t));
                     }
                 }
                 break;
@@ -399,11 +401,9 @@ static void insertNode( TreeNode * t)
             {
                 /* create and initialize new table. */
                 struct SymbolTable *newTable 
-                    = (struct SymbolTable *)malloc(sizeof(struct SymbolTable));
+                    = (struct SymbolTable *)calloc(1, sizeof(struct SymbolTable));
             
-                strncpy( newTable->functionName, 
-                         currentTable->functionName, 
-                         strlen(currentTable->functionName) + 1);
+                newTable->functionName = currentTable->functionName;
                 newTable->depth = currentTable->depth + 1;
                 newTable->child = NULL;
                 newTable->sibling = NULL;
@@ -440,10 +440,10 @@ static void insertNode( TreeNode * t)
 void buildSymtab(TreeNode * syntaxTree)
 {
     /* create global table. */
-    globalTable = (struct SymbolTable *)malloc(sizeof(struct SymbolTable));
+    globalTable = (struct SymbolTable *)calloc(1, sizeof(struct SymbolTable));
 
     /* initialize global table. */
-    strncpy(globalTable->functionName, "__GLOBAL__", 11);
+    globalTable->functionName = internString("__GLOBAL__");
     globalTable->depth = 0;
     globalTable->child = NULL;
     globalTable->sibling = NULL;
@@ -457,25 +457,25 @@ void buildSymtab(TreeNode * syntaxTree)
     /******************************************/
     /* add builtin functions. */
     /******************************************/
-    TreeNode *inputNode = (TreeNode *)malloc(sizeof(TreeNode));
+    TreeNode *inputNode = (TreeNode *)calloc(1, sizeof(TreeNode));
 
-    inputNode->attr.name = "input";
+    inputNode->attr.name = nameIndex(internString("input"));
     inputNode->lineno = 0;
     inputNode->type = Integer;
 
     st_insert(globalTable->hashTable, inputNode, 1, -1, 1, 0);
 
-    TreeNode *outputNode = (TreeNode *)malloc(sizeof(TreeNode));
+    TreeNode *outputNode = (TreeNode *)calloc(1, sizeof(TreeNode));
 
-    outputNode->attr.name = "output";
+    outputNode->attr.name = nameIndex(internString("output"));
     outputNode->lineno = 0;
     outputNode->type = Void;
 
     st_insert(globalTable->hashTable, outputNode, 1, -1, 1, 0);
 
     /* add param to output. */
-    BucketList outputHash = st_lookup(globalTable, "output");
-    outputHash->param = (BucketList)malloc(sizeof(*outputHash));
+    BucketList outputHash = st_lookup(globalTable, NAME(outputNode));
+    outputHash->param = (BucketList)calloc(1, sizeof(*outputHash));
     outputHash->param->type = Integer;
     outputHash->param->name = "arg";
 
@@ -506,13 +506,13 @@ static void checkNode(TreeNode * t)
             switch (t->kind.stmt)
             {
                 case ReturnStmt:
-                    if (t->child[0] == NULL)
+                    if (NODE(t->child[0]) == NULL)
                     {
                         returnType = Void;
                     }
                     else
                     {
-                        returnType = t->child[0]->type;
+                        returnType = NODE(t->child[0])->type;
                     }
 
                     lookupResult = st_lookup( globalTable,
@@ -542,19 +542,19 @@ static void checkNode(TreeNode * t)
             {
                 if (t->attr.op == ASSIGN)
                 {
-                    if (t->child[0]->type != t->child[1]->type)
+                    if (NODE(t->child[0])->type != NODE(t->child[1])->type)
                     {
                         typeError( t );
                     }
                     else
                     {
-                       t->type = t->child[0]->type;
+                       t->type = NODE(t->child[0])->type;
                     }
                 }
                 else if (t->attr.op != EQ && t->attr.op != NE)
                 {
-                    if (t->child[0]->type != Integer
-                            || t->child[1]->type != Integer)
+                    if (NODE(t->child[0])->type != Integer
+                            || NODE(t->child[1])->type != Integer)
                     {
                         typeError( t );
                     }
@@ -562,7 +562,7 @@ static void checkNode(TreeNode * t)
             }
             else if (t->kind.exp == IdExp)
             {
-                lookupResult = st_lookup(currentTable, t->attr.name);
+                lookupResult = st_lookup(currentTable, NAME(t));
                     
                 /* check parameters if function */
                 if (lookupResult != NULL)
@@ -591,3 +591,146 @@ void typeCheck(TreeNode * syntaxTree)
 {
     traverse(syntaxTree, forwardProc, checkNode);
 }
+
+/* names of the parameters and local variables in scope
+   in the function checked for purity, innermost last. */
+static char *localNames[MAX_SCOPE];
+static int localCount = 0;
+
+/* function checked for purity. */
+static BucketList pureFunction;
+
+/**
+ * returns 1 if name is a parameter or local variable in scope.
+ */
+static int isLocalName(char *name)
+{
+    int i;
+    for (i = localCount - 1; i >= 0; i--)
+    {
+        if (localNames[i] == name)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Function checkPure returns 1 if tree and its siblings
+ * read no global variable and call only pure functions
+ * or the function checked itself, which is then flagged
+ * as recursive
+ */
+static int checkPure(TreeNode * tree)
+{
+    int pure = 1;
+    int saved, i;
+    BucketList callee;
+
+    for ( ; tree != NULL; tree = NODE(tree->sibling))
+    {
+        switch (tree->nodekind)
+        {
+            case DeclareK:
+                /* local variable : shadows globals up to the end of its block. */
+                if (tree->kind.declaration != SizeDec)
+                {
+                    if (localCount == MAX_SCOPE)
+                    {
+                        return 0;
+                    }
+                    localNames[localCount++] = NAME(tree);
+                }
+                break;
+
+            case StmtK:
+                saved = localCount;
+                for (i = 0; i < MAXCHILDREN; i++)
+                {
+                    pure &= checkPure(NODE(tree->child[i]));
+                }
+                /* pop local variables of compound statement. */
+                localCount = saved;
+                break;
+
+            case ExpK:
+                if (tree->kind.exp == IdExp && !isLocalName(NAME(tree)))
+                {
+                    callee = st_lookup(globalTable, NAME(tree));
+
+                    /* global variable, or input and output. */
+                    if (callee == NULL || !callee->is_function)
+                    {
+                        pure = 0;
+                    }
+                    else if (callee == pureFunction)
+                    {
+                        pureFunction->is_recursive = 1;
+                    }
+                    else if (!callee->is_pure)
+                    {
+                        pure = 0;
+                    }
+                }
+                for (i = 0; i < MAXCHILDREN; i++)
+                {
+                    pure &= checkPure(NODE(tree->child[i]));
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return pure;
+}
+
+/* Procedure findPureFunctions flags the pure
+ * functions, and those that call themselves,
+ * in the symbol table. A function can only call
+ * itself and the functions declared before it,
+ * so one pass in order of declaration is enough.
+ */
+void findPureFunctions(TreeNode * syntaxTree)
+{
+    TreeNode *t, *param;
+    int pure;
+
+    for (t = syntaxTree; t != NULL; t = NODE(t->sibling))
+    {
+        if (t->nodekind != DeclareK
+                || t->kind.declaration != IdDec
+                || NODE(t->child[1]) == NULL
+                || NODE(t->child[1])->nodekind != StmtK)
+        {
+            continue;
+        }
+
+        pureFunction = st_lookup(globalTable, NAME(t));
+        if (pureFunction == NULL)
+        {
+            continue;
+        }
+
+        /* only int parameters : arrays are references. */
+        pure = 1;
+        localCount = 0;
+        for (param = NODE(t->child[0]); param != NULL; param = NODE(param->sibling))
+        {
+            if (param->type != Integer)
+            {
+                pure = 0;
+            }
+        }
+        pure &= checkPure(NODE(t->child[0]));
+        pure &= checkPure(NODE(t->child[1]));
+        pureFunction->is_pure = pure;
+
+        if (TraceAnalyze && pure)
+        {
+            fprintf(listing, "pure function %s%s\n", NAME(t),
+                    pureFunction->is_recursive ? " (recursive)" : "");
+        }
+    }
+}
@@ -18,4 +18,10 @@ void buildSymtab(TreeNode *);
  */
 void typeCheck(TreeNode *);
 
+/* Procedure findPureFunctions flags the pure
+ * functions, and those that call themselves,
+ * in the symbol table
+ */
+void findPureFunctions(TreeNode *);
+
 #endif
@@ -9,6 +9,7 @@
 
 #include "globals.h"
 #include "symtab.h"
+#include "util.h"
 #include "code.h"
 #include "cgen.h"
 
@@ -36,9 +37,217 @@ static int order = 0;
  */
 static int mainFunctionLoc;
 
+/*
+ * memo tables : next table location from global pointer,
+ * after the global variables, and total size.
+ */
+static int memoOffset = 0;
+static int memoWords = 0;
+
+/*
+ * stack depth of the current function : words below the memory
+ * pointer of its caller, now and at most (-1 if unbounded), and
+ * the maximum of each function by location.
+ */
+static int stackDepth = 0;
+static int maxDepth = 0;
+static int functionDepths[MAX_SYMBOL];
+
 /* prototype for internal recursive code generator */
 static void cGen (TreeNode * tree);
 
+/* Procedure noteDepth adds words to the stack depth
+ * of the current function (removes them if words < 0)
+ */
+static void noteDepth( int words)
+{
+    stackDepth += words;
+    if (maxDepth >= 0 && stackDepth > maxDepth)
+    {
+        maxDepth = stackDepth;
+    }
+}
+
+/* Procedure noteCall notes a call, at the current stack
+ * depth, of a function which needs depth words below it
+ * (-1 if unbounded)
+ */
+static void noteCall( int depth)
+{
+    if (depth < 0)
+    {
+        maxDepth = -1;
+    }
+    else if (maxDepth >= 0 && stackDepth + depth > maxDepth)
+    {
+        maxDepth = stackDepth + depth;
+    }
+}
+
+/* Function isMemoized returns TRUE if the function
+ * declared at tree is memoized : a pure recursive
+ * function returning int, when MemoSize is set
+ */
+static int isMemoized( TreeNode * tree, BucketList node)
+{
+    return (MemoSize > 0 && node->is_pure && node->is_recursive
+            && tree->type == Integer);
+}
+
+/* Procedure genMemo generates the memo wrapper of the
+ * function declared at tree, which its calls enter.
+ * The frame of the wrapper holds the k arguments, then
+ * the address of their table entry and the result.
+ * An entry has k + 2 words going down from its tag
+ * (1 once stored) : the arguments and the result.
+ * On a miss, the wrapper calls the body of the
+ * function, which follows it, and stores the result.
+ */
+static void genMemo( TreeNode * tree)
+{
+    TreeNode *param;
+    int k = 0;
+    int j, size, base;
+    int *missLoc;
+    int missTarget, hitLoc, keepLoc, callLoc, loadLoc;
+    int returnLoc, bodyLoc;
+    char *name, *comment;
+
+    for (param = NODE(tree->child[0]); param != NULL; param = NODE(param->sibling))
+    {
+        k++;
+    }
+    size = k + 2;
+    missLoc = (int *) malloc((k + 1) * sizeof(int));
+
+    /* reserve the table after the global variables. */
+    name = (char *) malloc(strlen(NAME(tree)) + 6);
+    sprintf(name, "%s.memo", NAME(tree));
+    base = memoOffset;
+    memoOffset += MemoSize * size;
+    memoWords += MemoSize * size;
+    emitData(name, base, MemoSize * size);
+
+    comment = (char *) malloc(strlen(name) + 11);
+    sprintf(comment, "Function: %s", name);
+    emitComment(comment);
+    free(comment);
+    emitFunction(name);
+
+    /* frame as for the function, with 2 more words. */
+    emitRM("ST", fp, -2, mp, "store previous frame pointer address.");
+    emitRM("LDA", fp, -3, mp, "fp = mp - 3");
+    emitRM("LDA", mp, -3 - k - 2, mp, "mp = mp - 3 - arguments - 2");
+
+    /* hash of the arguments, modulo the table size. */
+    emitComment("memo : hash arguments.");
+    if (k == 0)
+    {
+        emitRM("LDC", ac, 0, 0, "ac = 0");
+    }
+    else
+    {
+        emitRM("LD", ac, 0, fp, "ac = first argument");
+    }
+    for (j = 1; j < k; j++)
+    {
+        emitRM("MULI", ac, 31, ac, "ac = ac * 31");
+        emitRM("LD", ac1, -j, fp, "ac1 = next argument");
+        emitRO("ADD", ac, ac, ac1, "ac = ac + ac1");
+    }
+    emitRM("DIVI", ac1, MemoSize, ac, "ac1 = ac / table size");
+    emitRM("MULI", ac1, MemoSize, ac1, "ac1 = ac1 * table size");
+    emitRO("SUB", ac, ac, ac1, "ac = ac mod table size");
+    emitRM("JGE", ac, 1, pc, "skip if ac >= 0");
+    emitRM("LDA", ac, MemoSize, ac, "ac = ac + table size");
+
+    /* entry address : gp - base - index * size. */
+    emitRM("MULI", ac, size, ac, "ac = index * entry size");
+    emitRO("SUB", ac, gp, ac, "ac = gp - ac");
+    emitRM("LDA", ac, -base, ac, "ac = entry address");
+    emitRM("ST", ac, -k, fp, "store entry address to frame");
+
+    /* hit if the entry is stored with the same arguments. */
+    emitComment("memo : look up entry.");
+    emitRM("LD", ac1, 0, ac, "ac1 = tag of entry");
+    missLoc[0] = emitSkip(1);
+    for (j = 0; j < k; j++)
+    {
+        emitRM("LD", ac, -j, fp, "ac = argument");
+        emitRM("LD", ac1, -k, fp, "ac1 = entry address");
+        emitRM("LD", ac1, -1 - j, ac1, "ac1 = argument of entry");
+        missLoc[j + 1] = emitSkip(1);
+    }
+    emitRM("LD", ac1, -k, fp, "ac1 = entry address");
+    emitRM("LD", ac, -1 - k, ac1, "ac = result of entry");
+    hitLoc = emitSkip(1);
+
+    /* miss : call the body with the arguments. */
+    missTarget = emitSkip(0);
+    emitBackup(missLoc[0]);
+    emitRM_Abs("JEQ", ac1, missTarget, "miss if entry is empty");
+    for (j = 1; j <= k; j++)
+    {
+        emitBackup(missLoc[j]);
+        emitRB_Abs("BNE", ac, ac1, missTarget, "miss if arguments differ");
+    }
+    emitRestore();
+    free(missLoc);
+
+    emitComment("memo : miss, call function body.");
+    for (j = 0; j < k; j++)
+    {
+        emitRM("LD", ac, -j, fp, "ac = argument");
+        emitRM("ST", ac, -3 - j, mp, "memory[mp+offset] = ac");
+    }
+    emitRM("ST", pc, -1, mp, "store return address to stack");
+    callLoc = emitSkip(1);
+
+    /* store the result with the arguments in the entry. */
+    emitComment("memo : store result.");
+    emitRM("ST", ac, -1 - k, fp, "store result to frame");
+    emitRM("LD", ac1, -k, fp, "ac1 = entry address");
+    keepLoc = -1;
+    if (!MemoEvict)
+    {
+        emitRM("LD", ac, 0, ac1, "ac = tag of entry");
+        keepLoc = emitSkip(1);
+        emitRM("LD", ac, -1 - k, fp, "ac = result");
+    }
+    emitRM("ST", ac, -1 - k, ac1, "result of entry = ac");
+    for (j = 0; j < k; j++)
+    {
+        emitRM("LD", ac, -j, fp, "ac = argument");
+        emitRM("ST", ac, -1 - j, ac1, "argument of entry = ac");
+    }
+    emitRM("ST", constant, 0, ac1, "tag of entry = 1");
+    loadLoc = emitSkip(0);
+    emitRM("LD", ac, -1 - k, fp, "ac = result");
+
+    /* return as the function does. */
+    returnLoc = emitSkip(0);
+    emitComment("Return Statements.");
+    emitRM("LDA", mp, 3, fp, "mp = fp + 3");
+    emitRM("LD", fp, 1, fp, "set fp to previous frame pointer.");
+    emitRM("LD", ac1, -1, mp, "set ac1 to previous address.");
+    emitRO("ADD", pc, ac1, constant, "pc = previous address + 1");
+    emitComment("Return Statements ended.");
+    emitFunction(NULL);
+
+    /* backpatch jumps : the body follows. */
+    bodyLoc = emitSkip(0);
+    emitBackup(hitLoc);
+    emitRM_Abs("JEQ", zero, returnLoc, "hit : return result of entry");
+    if (keepLoc >= 0)
+    {
+        emitBackup(keepLoc);
+        emitRM_Abs("JNE", ac, loadLoc, "keep entry if stored");
+    }
+    emitBackup(callLoc);
+    emitRM_Abs("LDA", pc, bodyLoc, "jump to function body");
+    emitRestore();
+}
+
 /* Procedure genDeclare generates code at a declaration node */
 static void genDeclare( TreeNode * tree)
 {
@@ -46,80 +255,107 @@ static void genDeclare( TreeNode * tree)
     BucketList node;
     int loc, currentLoc;
     int size;
+    char *comment;
 
     switch(tree->kind.declaration)
     {
         /* name of variable or function. */
         case IdDec:
             /* function */
-            if (tree->child[1] != NULL && tree->child[1]->nodekind == StmtK)
+            if (NODE(tree->child[1]) != NULL && NODE(tree->child[1])->nodekind == StmtK)
             {
                 /* increment global offset. */
                 globalOffset += 1;
 
                 /* set tmpTable for parameters. */
                 tmpTable = currentTable->child;
-                while (strcmp(tmpTable->functionName, tree->attr.name) != 0)
+                while (tmpTable->functionName != NAME(tree))
                 {
                     tmpTable = tmpTable->sibling;
                 }
 
                 /* get location of function. */
-                loc = st_lookup(currentTable, tree->attr.name)->location;
+                node = st_lookup(currentTable, NAME(tree));
+                loc = node->location;
 
                 /* store current location to array. */
                 currentLoc = emitSkip(0);
                 functionLocations[loc] = currentLoc;
 
+                /* calls of the function to itself are unbounded. */
+                functionDepths[loc] = -1;
+
+                /* memoized function : calls enter the memo wrapper. */
+                if (isMemoized(tree, node))
+                {
+                    genMemo(tree);
+                }
+
+                /* frame : previous frame pointer, return address. */
+                stackDepth = 0;
+                maxDepth = 0;
+                noteDepth(3);
+
                 /* store main function's location. */
-                if (strcmp(tree->attr.name, "main") == 0)
+                if (strcmp(NAME(tree), "main") == 0)
                 {
                     mainFunctionLoc = currentLoc;
                 }
 
+                /* name the function entry for the profiler of tm. */
+                comment = (char *) malloc(strlen(NAME(tree)) + 11);
+                sprintf(comment, "Function: %s", NAME(tree));
+                emitComment(comment);
+                free(comment);
+                emitFunction(NAME(tree));
+
                 /* push previous frame pointer address. */
                 emitRM("ST", fp, -2, mp, "store previous frame pointer address.");
 
                 /* set frame pointer. */
-                emitRM_Abs("LDA", ac, 3, "load value 3 to ac.");
-                emitRO("SUB", fp, mp, ac, "fp = mp - 3");
-                emitRO("SUB", mp, mp, ac, "mp = mp - 3");
+                emitRM("LDA", fp, -3, mp, "fp = mp - 3");
+                emitRM("LDA", mp, -3, mp, "mp = mp - 3");
 
                 /* generate code of current function :
                    calculate memory for parameters.
                    setting stack pointer would be done in next phase.*/
-                cGen(tree->child[0]);
+                cGen(NODE(tree->child[0]));
 
                 /* generate code of current function :
                    handle compound statements.
                    this would calculate local variables, and set stack pointer. */
-                cGen(tree->child[1]);
+                cGen(NODE(tree->child[1]));
 
                 /* create return instruction :
                    do not use ac, since it has return value. */
                 emitComment("Return Statements.");
-                emitRM_Abs("LDA", ac1, 3, "load value 3 to ac1.");
-                emitRO("ADD", mp, fp, ac1, "mp = fp + 3");
+                emitRM("LDA", mp, 3, fp, "mp = fp + 3");
                 emitRM("LD", fp, 1, fp, "set fp to previous frame pointer.");
                 emitRM("LD", ac1, -1, mp, "set ac1 to previous address.");
                 emitRO("ADD", pc, ac1, constant, "pc = previous address + 1");
                 emitComment("Return Statements ended.");
+                emitFunction(NULL);
+
+                functionDepths[loc] = maxDepth;
             }
             /* variable */
             else
             {
-                node = st_lookup(currentTable, tree->attr.name);
+                node = st_lookup(currentTable, NAME(tree));
                 if (node != NULL)
                 {
                     if (node->type == IntegerArray)
                     {
-                        size = tree->child[0]->attr.val;
+                        size = NODE(tree->child[0])->attr.val;
                     }
                     else
                     {
                         size = 1;
                     }
 
+                    /* enter variable into the line table of tm. */
+                    emitData(NAME(tree), node->location, size);
+
                     /* increment offset. */
                     if (node->is_global)
                     {
@@ -140,7 +376,7 @@ static void genDeclare( TreeNode * tree)
 
         /* name of parameter variable. */
         case ParamDec:
-            node = st_lookup(tmpTable, tree->attr.name);
+            node = st_lookup(tmpTable, NAME(tree));
             if (node != NULL)
             {
                 /* handle array as reference, so size is 1. */
@@ -158,6 +394,179 @@ static void genDeclare( TreeNode * tree)
     }
 } /* genDeclare */
 
+/* Function isConstant returns TRUE if tree is a constant
+ * number, which can be used as an immediate operand
+ */
+static int isConstant( TreeNode * tree)
+{
+    return (tree != NULL && tree->nodekind == ExpK
+            && tree->kind.exp == ConstExp);
+}
+
+/* Procedure genOperands generates code for both operands
+ * of a binary operator : left value in ac, right value in ac1.
+ */
+static void genOperands( TreeNode * tree)
+{
+    /* constant right operand : no need to store on stack. */
+    if (isConstant(NODE(tree->child[1])))
+    {
+        cGen(NODE(tree->child[0]));
+        emitRM("LDC", ac1, NODE(tree->child[1])->attr.val, 0, "ac1 = constant");
+        return;
+    }
+
+    /* get expression value from right, and store on stack. */
+    cGen(NODE(tree->child[1]));
+    emitRM("ST", ac, -1, mp, "mem[mp - 1] = right expression");
+    emitRO("SUB", mp, mp, constant, "mp = mp - 1");
+    noteDepth(1);
+
+    /* get expression value from left, and pop right to ac1. */
+    cGen(NODE(tree->child[0]));
+    emitRO("ADD", mp, mp, constant, "mp = mp + 1");
+    emitRM("LD", ac1, -1, mp, "ac1 = mem[mp - 1]");
+    noteDepth(-1);
+} /* genOperands */
+
+/* Procedure genAssign generates code for an assignment :
+ * left(child[0]) is var, right(child[1]) is expression.
+ */
+static void genAssign( TreeNode * tree)
+{
+    TreeNode *left = NODE(tree->child[0]);
+    TreeNode *index = NODE(left->child[0]);
+    BucketList var = st_lookup(currentTable, NAME(left));
+    int location = 0 - var->location;
+    int base = (var->is_global == 1) ? gp : fp;
+
+    /* plain variable, or array itself :
+       get reference by frame/global pointer. */
+    if (var->type != IntegerArray || index == NULL)
+    {
+        /* get expression value from right. */
+        cGen(NODE(tree->child[1]));
+
+        /* C-Minus do not support pointer expression,
+           so array itself is left in blank. */
+        if (var->type != IntegerArray)
+        {
+            emitRM("ST", ac, location, base, "memory[base - location] = ac");
+        }
+    }
+    /* constant index : fold into offset. */
+    else if (isConstant(index) && var->is_param != 1)
+    {
+        cGen(NODE(tree->child[1]));
+        emitRM("ST", ac, location - index->attr.val, base,
+                "memory[base - location - index] = ac");
+    }
+    else
+    {
+        /* store right expression value on stack. */
+        cGen(NODE(tree->child[1]));
+        emitRM("ST", ac, -1, mp, "mem[mp - 1] = right expression");
+        emitRO("SUB", mp, mp, constant, "mp = mp - 1");
+        noteDepth(1);
+
+        /* generate expression code for offset.
+           register 'ac' has the offset. */
+        cGen(index);
+
+        /* if parameter, resolve reference. */
+        if (var->is_param == 1)
+        {
+            emitRM("LD", ac1, location, fp, "load reference to ac1.");
+            emitRO("SUB", ac, ac1, ac, "ac = ac1 - ac");
+        }
+
+        /* pop right expression value to ac1. */
+        emitRO("ADD", mp, mp, constant, "mp = mp + 1");
+        emitRM("LD", ac1, -1, mp, "ac1 = mem[mp - 1]");
+        noteDepth(-1);
+
+        if (var->is_param == 1)
+        {
+            emitRM("ST", ac1, 0, ac, "memory[ac] = ac1");
+        }
+        else
+        {
+            emitRX("STX", ac1, location, base, ac,
+                    "memory[base - location - ac] = ac1");
+        }
+    }
+} /* genAssign */
+
+/* Function genCondition generates code for the condition
+ * of a selection or iteration statement. relational operators
+ * leave their operands in ac, ac1 instead of a value in ac.
+ * It returns the location skipped for the conditional jump,
+ * which is filled later by genCondJump.
+ */
+static int genCondition( TreeNode * tree)
+{
+    if (tree != NULL && tree->nodekind == ExpK && tree->kind.exp == OpExp
+            && (tree->attr.op == EQ || tree->attr.op == NE
+                || tree->attr.op == LT || tree->attr.op == GT
+                || tree->attr.op == LE || tree->attr.op == GE))
+    {
+        /* left value to ac, right value to ac1. */
+        genOperands(tree);
+    }
+    else
+    {
+        /* plain expression : ac == 0 is true. */
+        cGen(tree);
+    }
+
+    return emitSkip(1);
+} /* genCondition */
+
+/* Procedure genCondJump backpatches the location skipped by
+ * genCondition with a jump to target taken if the condition
+ * is false.
+ */
+static void genCondJump( TreeNode * tree, int loc, int target)
+{
+    emitBackup(loc);
+
+    if (tree != NULL && tree->nodekind == ExpK && tree->kind.exp == OpExp)
+    {
+        /* branch with the opposite of the relational operator. */
+        switch (tree->attr.op)
+        {
+            case EQ:
+                emitRB_Abs("BNE", ac, ac1, target, "jump if not ac == ac1");
+                return;
+
+            case NE:
+                emitRB_Abs("BEQ", ac, ac1, target, "jump if not ac != ac1");
+                return;
+
+            case LT:
+                emitRB_Abs("BGE", ac, ac1, target, "jump if not ac < ac1");
+                return;
+
+            case GT:
+                emitRB_Abs("BLE", ac, ac1, target, "jump if not ac > ac1");
+                return;
+
+            case LE:
+                emitRB_Abs("BGT", ac, ac1, target, "jump if not ac <= ac1");
+                return;
+
+            case GE:
+                emitRB_Abs("BLT", ac, ac1, target, "jump if not ac >= ac1");
+                return;
+
+            default:
+                break;
+        }
+    }
+
+    emitRM_Abs("JNE", ac, target, "jump if ac != 0.");
+} /* genCondJump */
+
 /* Procedure genStmt generates code at a statement node */
 static void genStmt( TreeNode * tree)
 {
@@ -175,24 +584,24 @@ static void genStmt( TreeNode * tree)
             currentTable = findNewTableInOrder(globalTable, order);
 
             /* calculate local offset. */
-            cGen(tree->child[0]);
+            cGen(NODE(tree->child[0]));
 
             /* store current localOffset. */
             offset = localOffset;
 
             /* set stack pointer. */
-            emitRM_Abs("LDA", ac, offset, "load size of local vars to ac.");
-            emitRO("SUB", mp, mp, ac, "mp = mp - localOffset");
+            emitRM("LDA", mp, -offset, mp, "mp = mp - localOffset");
+            noteDepth(offset);
 
             /* set local offset into 0, since setting stack pointer is finished. */
             localOffset = 0;
 
             /* generate code for statements. */
-            cGen(tree->child[1]);
+            cGen(NODE(tree->child[1]));
 
             /* reset stack pointer since compound statement has ended. */
-            emitRM_Abs("LDA", ac1, offset, "load size of local vars to ac1.");
-            emitRO("ADD", mp, mp, ac1, "mp = mp + localOffset");
+            emitRM("LDA", mp, offset, mp, "mp = mp + localOffset");
+            noteDepth(-offset);
 
             /* restore table. */
             currentTable = currentTable->parent;
@@ -202,25 +611,21 @@ static void genStmt( TreeNode * tree)
         /* middle(child[1]) : statement(includes every kind of statement) */
         /* right(child[2]) : statement or NULL. [1] is inside if, [2] is else. */
         case SelectionStmt:
-            /* generate code for expression. */
-            cGen(tree->child[0]);
-
-            /* save current location. */
-            firstLoc = emitSkip(2);
+            /* generate code for condition, save jump location. */
+            firstLoc = genCondition(NODE(tree->child[0]));
 
             /* generate code for statements in 'if'. */
-            firstBlock = emitSkip(0);
-            cGen(tree->child[1]);
+            cGen(NODE(tree->child[1]));
 
             /* generate code for statements in 'else'.
                if no 'else', secondBlock would point to the next statement. */
             secondBlock = emitSkip(0);
-            if (tree->child[2] != NULL && tree->child[2]->nodekind != EmptyK)
+            if (NODE(tree->child[2]) != NULL && NODE(tree->child[2])->nodekind != EmptyK)
             {
                 secondLoc = emitSkip(1);
                 secondBlock = emitSkip(0);
 
-                cGen(tree->child[2]);
+                cGen(NODE(tree->child[2]));
                 currentLoc = emitSkip(0);
 
                 /* make jump for 'if' statement. */
@@ -228,10 +633,8 @@ static void genStmt( TreeNode * tree)
                 emitRM_Abs("JEQ", zero, currentLoc, "jump to nonconditional area.");
             }
 
-            /* set jump condition to restored area. */
-            emitBackup(firstLoc);
-            emitRM_Abs("JEQ", ac, firstBlock, "jump to firstBlock if ac == 0.");
-            emitRM_Abs("JNE", ac, secondBlock, "jump to secondBlock if ac != 0.");
+            /* jump to secondBlock if condition is false. */
+            genCondJump(NODE(tree->child[0]), firstLoc, secondBlock);
 
             /* restore location. */
             emitRestore();
@@ -243,14 +646,11 @@ static void genStmt( TreeNode * tree)
             /* save the start of loop block. */
             firstBlock = emitSkip(0);
 
-            /* generate code for expresion. */
-            cGen(tree->child[0]);
-
-            /* save current location. */
-            firstLoc = emitSkip(1);
+            /* generate code for condition, save jump location. */
+            firstLoc = genCondition(NODE(tree->child[0]));
 
             /* generate code for statements in 'while'. */
-            cGen(tree->child[1]);
+            cGen(NODE(tree->child[1]));
 
             /* add non-conditional jump for loop. */
             emitRM_Abs("JEQ", zero, firstBlock, "loop of firstBlock.");
@@ -258,9 +658,8 @@ static void genStmt( TreeNode * tree)
             /* get current location. */
             secondBlock = emitSkip(0);
 
-            /* set jump condition to restored area. */
-            emitBackup(firstLoc);
-            emitRM_Abs("JNE", ac, secondBlock, "jump to secondBlock if ac != 0.");
+            /* jump to secondBlock if condition is false. */
+            genCondJump(NODE(tree->child[0]), firstLoc, secondBlock);
 
             /* restore location. */
             emitRestore();
@@ -269,7 +668,7 @@ static void genStmt( TreeNode * tree)
         /* child[0] : expression or NULL */
         case ReturnStmt:
             /* generate code for expression. */
-            cGen(tree->child[0]);
+            cGen(NODE(tree->child[0]));
             
             /* returned value is already in register 'ac'. */
             break;
@@ -284,142 +683,57 @@ static void genStmt( TreeNode * tree)
 static void genExp( TreeNode * tree)
 {
     BucketList var;
-    int location;
-    TreeNode *param, *left;
-    int offset;
-
-    int firstLoc, secondLoc;
+    int location, base;
+    TreeNode *param;
+    int offset, value;
 
     switch(tree->kind.exp)
     {
         /* if ASSIGN : left is var, right is expression. */
         /* else : left and right both expression. */
         case OpExp:
-            /* get expression value from right. */
-            cGen(tree->child[1]);
-
-            /* store right expression value on stack. */
-            emitRM("ST", ac, -1, mp, "mem[mp - 1] = right expression");
-
-            /* push mp 1. */
-            emitRO("SUB", mp, mp, constant, "mp = mp - 1");
+            if (tree->attr.op == ASSIGN)
+            {
+                genAssign(tree);
+                break;
+            }
 
-            /* if not assign, get left value and store to ac. */
-            if (tree->attr.op != ASSIGN)
+            /* constant right operand : use immediate operand. */
+            if (isConstant(NODE(tree->child[1]))
+                    && (tree->attr.op == PLUS || tree->attr.op == MINUS
+                        || tree->attr.op == TIMES || tree->attr.op == OVER))
             {
                 /* get expression value from left. */
-                cGen(tree->child[0]);
+                cGen(NODE(tree->child[0]));
+
+                value = NODE(tree->child[1])->attr.val;
+                switch(tree->attr.op)
+                {
+                    case PLUS:
+                        emitRM("LDA", ac, value, ac, "ac = ac + constant");
+                        break;
+
+                    case MINUS:
+                        emitRM("LDA", ac, -value, ac, "ac = ac - constant");
+                        break;
 
-                /* pop mp 1. */
-                emitRO("ADD", mp, mp, constant, "mp = mp + 1");
+                    case TIMES:
+                        emitRM("MULI", ac, value, ac, "ac = ac * constant");
+                        break;
 
-                /* load right expression value to ac1. */
-                emitRM("LD", ac1, -1, mp, "ac1 = mem[mp - 1]");
+                    case OVER:
+                        emitRM("DIVI", ac, value, ac, "ac = ac / constant");
+                        break;
+                }
+                break;
             }
 
+            /* left value to ac, right value to ac1. */
+            genOperands(tree);
+
             /* handle according to the values. */
             switch(tree->attr.op)
             {
-                case ASSIGN:
-                    left = tree->child[0];
-                    var = st_lookup(currentTable, left->attr.name);
-                    location = 0 - var->location;
-
-                    /* array : handle reference. */
-                    if (var->type == IntegerArray)
-                    {
-                        /* if pointing array itself, resolve reference. */
-                        if (left->child[0] == NULL)
-                        {
-                            /* pop mp 1. */
-                            emitRO("ADD", mp, mp, constant, "mp = mp + 1");
-
-                            /* load right expression value to ac1. */
-                            emitRM("LD", ac1, -1, mp, "ac1 = mem[mp - 1]");
-
-                            /* C-Minus do not support pointer expression,
-                               so this would be left in blank.
-                               just resolved mp to original state. */
-                        }
-                        /* if pointing array's element, calculate offset. */
-                        else
-                        {
-                            /* generate expression code for offset.
-                               register 'ac' has the offset. */
-                            cGen(left->child[0]);
-
-                            /* if parameter. resolve reference. */
-                            if (var->is_param == 1)
-                            {
-                                /* register 'ac' has the index. */
-
-                                emitRM("LD", ac1, location, fp,
-                                        "load reference to ac1.");
-                                emitRO("SUB", ac1, ac1, ac, "ac1 = ac1 - ac");
-
-                                /* store ac1's value to ac. */
-                                emitRO("ADD", ac, ac1, zero, "ac = ac1");
-
-                                /* pop mp 1. */
-                                emitRO("ADD", mp, mp, constant, "mp = mp + 1");
-
-                                /* load right expression value to ac1. */
-                                emitRM("LD", ac1, -1, mp, "ac1 = mem[mp - 1]");
-
-                                /* store ac1's value to stack. */
-                                emitRM("ST", ac1, 0, ac, "memory[ac] = ac1");
-                            }
-                            /* else, calculate offset. */
-                            else
-                            {
-                                /* if global array, calculate from gp. */
-                                if (var->is_global == 1)
-                                {
-                                    emitRO("SUB", ac, gp, ac, "ac = gp - offset");
-                                }
-                                /* else, calculate from fp. */
-                                else
-                                {
-                                    emitRO("SUB", ac, fp, ac, "ac = fp - offset");
-                                }
-
-                                /* pop mp 1. */
-                                emitRO("ADD", mp, mp, constant, "mp = mp + 1");
-
-                                /* load right expression value to ac1. */
-                                emitRM("LD", ac1, -1, mp, "ac1 = mem[mp - 1]");
-
-                                /* store right expression value to stack. */
-                                emitRM("ST", ac1, location, ac,
-                                        "memory[ac - location] = ac1");
-                            }
-                        }
-                    }
-                    /* plain variable :
-                       get reference by frame/global pointer. */
-                    else
-                    {
-                        /* pop mp 1. */
-                        emitRO("ADD", mp, mp, constant, "mp = mp + 1");
-
-                        /* load right expression value to ac1. */
-                        emitRM("LD", ac1, -1, mp, "ac1 = mem[mp - 1]");
-                        
-                        /* global variable : subtract from global pointer. */
-                        if (var->is_global == 1)
-                        {
-                            emitRM("ST", ac1, location, gp,
-                                    "memory[gp - location] = ac1");
-                        }
-                        /* local variable : subtract from frame pointer. */
-                        else
-                        {
-                            emitRM("ST", ac1, location, fp,
-                                    "memory[fp - location] = ac1");
-                        }
-                    }
-                    break;
-
                 case PLUS:
                     emitRO("ADD", ac, ac, ac1, "ac = ac + ac1");
                     break;
@@ -485,13 +799,13 @@ static void genExp( TreeNode * tree)
 
         /* only constant number. */
         case ConstExp:
-            emitRM_Abs("LDA", ac, tree->attr.val, "load constant value to ac.");
+            emitRM("LDC", ac, tree->attr.val, 0, "load constant value to ac.");
             break;
 
         /* variable ID. */
         case IdExp:
             /* lookup variable from symbol table. */
-            var = st_lookup(currentTable, tree->attr.name);
+            var = st_lookup(currentTable, NAME(tree));
             location = 0 - var->location;
             
             /* function call. */
@@ -502,7 +816,7 @@ static void genExp( TreeNode * tree)
                 if (location == -1)
                 {
                     /* input */
-                    if (strcmp(tree->attr.name, "input") == 0)
+                    if (strcmp(NAME(tree), "input") == 0)
                     {
                         /* read integer value to ac. */
                         emitRO("IN", ac, 0, 0, "read integer value");
@@ -511,7 +825,7 @@ static void genExp( TreeNode * tree)
                     else
                     {
                         /* generate expression from parameter. */
-                        cGen(tree->child[0]);
+                        cGen(NODE(tree->child[0]));
 
                         /* write value from expression, which is stored in ac. */
                         emitRO("OUT", ac, 0, 0, "write integer value");
@@ -519,11 +833,14 @@ static void genExp( TreeNode * tree)
                 }
                 else
                 {
+                    /* the frame of the function is below mp. */
+                    noteCall(functionDepths[location]);
+
                     /* get function's real location. */
                     location = functionLocations[location];
 
                     /* set function variables. */
-                    param = tree->child[0];
+                    param = NODE(tree->child[0]);
                     offset = -3; /* above sfp, return address. */
                     emitComment("putting arguments");
                     while(param != NULL)
@@ -536,7 +853,7 @@ static void genExp( TreeNode * tree)
 
                         /* advance. */
                         offset--;
-                        param = param->sibling;
+                        param = NODE(param->sibling);
                     }
                     emitComment("argument put on stack");
 
@@ -551,14 +868,11 @@ static void genExp( TreeNode * tree)
                child[0] is expression. */
             else if (var->type == IntegerArray)
             {
-                /* gererate code for expression : ac has the size of array. */
-                cGen(tree->child[0]);
-
                 /* handle array in parameter : reference. */
                 if (var->is_param == 1)
                 {
                     /* if called array itself, return reference. */
-                    if (tree->child[0] == NULL)
+                    if (NODE(tree->child[0]) == NULL)
                     {
                         emitRM("LD", ac, location, fp, "load reference to ac.");
                     }
@@ -566,41 +880,37 @@ static void genExp( TreeNode * tree)
                     else
                     {
                         /* register 'ac' has the index. */
+                        cGen(NODE(tree->child[0]));
 
                         emitRM("LD", ac1, location, fp, "load reference to ac1.");
-                        emitRO("SUB", ac1, ac1, ac, "ac1 = ac1 - ac");
-                        emitRM("LD", ac, 0, ac1, "ac = memory[ac1]");
+                        emitRX("LDX", ac, 0, ac1, ac, "ac = memory[ac1 - ac]");
                     }
                 }
                 /* handle array : add size from array. */
                 else
                 {
+                    /* global variable : subtract from global pointer.
+                       local variable : subtract from frame pointer. */
+                    base = (var->is_global == 1) ? gp : fp;
+
                     /* if called array itself, return reference. */
-                    if (tree->child[0] == NULL)
+                    if (NODE(tree->child[0]) == NULL)
                     {
-                        emitRM_Abs("LDA", ac, location, "load -location to ac");
-                        /* global variable : gp - location */
-                        if (var->is_global == 1)
-                        {
-                            emitRO("ADD", ac, gp, ac, "ac = gp - location");
-                        }
-                        /* local variable : fp - location */
-                        else
-                        {
-                            emitRO("ADD", ac, fp, ac, "ac = fp - location");
-                        }
+                        emitRM("LDA", ac, location, base, "ac = base - location");
                     }
-                    /* global variable : subtract from global pointer. */
-                    else if (var->is_global == 1)
+                    /* constant index : fold into offset. */
+                    else if (isConstant(NODE(tree->child[0])))
                     {
-                        emitRO("SUB", ac1, gp, ac, "ac1 = gp - offset");
-                        emitRM("LD", ac, location,ac1,"ac = memory[ac1 - location]");
+                        emitRM("LD", ac, location - NODE(tree->child[0])->attr.val, base,
+                                "ac = memory[base - location - index]");
                     }
-                    /* local variable : subtract from frame pointer. */
                     else
                     {
-                        emitRO("SUB", ac1, fp, ac, "ac1 = fp - offset");
-                        emitRM("LD", ac, location,ac1,"ac = memory[ac1 - location]");
+                        /* register 'ac' has the index. */
+                        cGen(NODE(tree->child[0]));
+
+                        emitRX("LDX", ac, location, base, ac,
+                                "ac = memory[base - location - ac]");
                     }
                 }
             }
@@ -627,12 +937,18 @@ static void genExp( TreeNode * tree)
 } /* genExp */
 
 /* Procedure cGen recursively generates code by
- * tree traversal
+ * tree traversal : it loops over siblings, so its
+ * depth is the nesting depth
  */
 static void cGen( TreeNode * tree)
 {
-    if (tree != NULL)
+    int line;
+
+    while (tree != NULL)
     {
+        /* instructions of this node map to its source line. */
+        line = emitLine(tree->lineno);
+
         switch (tree->nodekind)
         {
             case DeclareK:
@@ -655,7 +971,8 @@ static void cGen( TreeNode * tree)
                 break;
         }
 
-        cGen(tree->sibling);
+        emitLine(line);
+        tree = NODE(tree->sibling);
     }
 }
 
@@ -672,9 +989,27 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
 {
     char * s = malloc(strlen(codefile)+7);
     int entryPoint;
+    TreeNode * t;
+    BucketList node;
+    char comment[64];
 
     currentTable = globalTable;
 
+    /* memo tables follow the global variables. */
+    memoOffset = 0;
+    memoWords = 0;
+    for (t = syntaxTree; t != NULL; t = NODE(t->sibling))
+    {
+        if (t->nodekind == DeclareK && t->type == IntegerArray)
+        {
+            memoOffset += NODE(t->child[0])->attr.val;
+        }
+        else if (t->nodekind == DeclareK)
+        {
+            memoOffset += 1;
+        }
+    }
+
     strcpy(s,"File: ");
     strcat(s,codefile);
 
@@ -692,8 +1027,8 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
 
     emitComment("End of standard prelude.");
 
-    /* skip codes for 6 : leave space for entry point. */
-    entryPoint = emitSkip(6);
+    /* skip codes for 5 : leave space for entry point. */
+    entryPoint = emitSkip(5);
 
     /* generate code for TINY program */
     cGen(syntaxTree);
@@ -701,10 +1036,12 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
     /* restore to entry point. */
     emitBackup(entryPoint);
 
+    /* reserve memo tables with the global variables. */
+    globalOffset += memoWords;
+
     /* increase fp, mp. */
-    emitRM_Abs("LDA", ac, globalOffset, "set ac to globalOffset.");
-    emitRO("SUB", mp, mp, ac, "mp = mp - ac");
-    emitRO("SUB", fp, fp, ac, "fp = fp - ac");
+    emitRM("LDA", mp, -globalOffset, mp, "mp = mp - globalOffset");
+    emitRM("LDA", fp, -globalOffset, fp, "fp = fp - globalOffset");
 
     /* call main function. */
     emitComment("Function Call Statements.");
@@ -715,4 +1052,18 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
     /* finish */
     emitComment("End of execution.");
     emitRO("HALT",0,0,0,"");
+
+    /* data memory for tm : location 0, global variables and
+       the stack of main, unless recursion leaves it unbounded. */
+    node = st_lookup(globalTable, internString("main"));
+    if (node != NULL && functionDepths[node->location] >= 0)
+    {
+        sprintf(comment, "Data memory: %d",
+                1 + globalOffset + functionDepths[node->location]);
+        emitComment(comment);
+    }
+    else
+    {
+        emitComment("Data memory: unbounded, by recursion");
+    }
 }
@@ -8,49 +8,59 @@
 #include "util.h"
 #include "scan.h"
 
-#define YYSTYPE TreeNode *
-static char * savedName; /* for use in assignments */
-static int savedNum;     /* for use in declarations */
-static TreeNode * savedTree; /* stores syntax tree for later return */
+static NodeIndex savedTree; /* stores syntax tree for later return */
+static int savedLineNo; /* line of the last ID scanned */
 static int yylex(void); // added 11/2/11 to ensure no conflict with lex
 
+/* list rules append in constant time : their value is
+ * the last node of a circular list, whose sibling is
+ * the first node, until closeList ends the list
+ */
+static NodeIndex appendList(NodeIndex list, NodeIndex t);
+static NodeIndex closeList(NodeIndex list);
+
 %}
 
+/* semantic values : nodes by index, as treeNodes
+ * moves while it grows; identifiers come from the
+ * scanner interned, and numbers converted
+ */
+%union
+{
+	unsigned int node; /* NodeIndex, defined after y.tab.h */
+	char * name;
+	int val;
+}
+
 %token IF ELSE WHILE RETURN INT VOID
-%token ID NUM 
+%token <name> ID
+%token <val> NUM
 %token ASSIGN EQ NE LT LE GT GE PLUS MINUS TIMES OVER LPAREN RPAREN
 %token LCURLY RCURLY LBRACE RBRACE SEMI COMMA
 %token ERROR 
 
+%type <node> declaration_list declaration var_declaration func_declaration
+%type <node> params param_list param compound_stmt local_declarations
+%type <node> statement_list statement expression_stmt selection_stmt
+%type <node> iteration_stmt return_stmt expression var simple_expression
+%type <node> add_expression term factor call args args_list
+%type <val> type_specifier relop addop mulop
+
 %% /* Grammar for TINY */
 
 program				: declaration_list
 						{
-							savedTree = $1;
+							savedTree = closeList($1);
 						}
 					;
 
 declaration_list	: declaration_list declaration
 						{
-							YYSTYPE node = $1;
-
-							if (node == NULL)
-								$$ = $2;
-							else
-							{
-								while (node->sibling != NULL)
-								{
-									node = node->sibling;
-								}
-
-								node->sibling = $2;
-
-								$$ = $1;
-							}
+							$$ = appendList($1, $2);
 						}
 					| declaration
 						{
-							$$ = $1;
+							$$ = appendList(0, $1);
 						}
 					;
 
@@ -66,107 +76,82 @@ declaration			: var_declaration
 
 var_declaration		: type_specifier ID SEMI
 					  	{
-							/* get string from stack. */
-							StackNode *tokenNode = PopStack(&top);
-							savedName = copyString(tokenNode->token);
-							free(tokenNode);
-
 							/* create new node. */
 							$$ = newDeclareNode(IdDec);
 
-							$$->attr.name = copyString(savedName);
-                            $$->type = (Type)$1;
-							free(savedName);
+							NODE($$)->attr.name = nameIndex($2);
+                            NODE($$)->type = (Type)$1;
 						}
 					| type_specifier ID LBRACE NUM RBRACE SEMI
 					  	{
-							/* get size from stack. */
-							StackNode *tokenNode = PopStack(&top);
-							savedNum = atoi(tokenNode->token);
-							free(tokenNode);
-
-							/* get string from stack. */
-							tokenNode = PopStack(&top);
-							savedName = copyString(tokenNode->token);
-							free(tokenNode);
-
 							/* create new node. */
 							$$ = newDeclareNode(IdDec);
 
-							$$->attr.name = copyString(savedName);
+							NODE($$)->attr.name = nameIndex($2);
                             if ((Type)$1 == Integer)
                             {
-                                $$->type = IntegerArray;
+                                NODE($$)->type = IntegerArray;
                             }
                             else
                             {
-                                $$->type = VoidArray;
+                                NODE($$)->type = VoidArray;
                             }
-							free(savedName);
 
-							$$->child[0] = newDeclareNode(SizeDec);
-							$$->child[0]->attr.val = savedNum;
+							NodeIndex size = newDeclareNode(SizeDec);
+							NODE(size)->attr.val = $4;
+							NODE($$)->child[0] = size;
 						}
 					;
 
 type_specifier		: INT
 						{
-							$$ = (YYSTYPE)Integer;
+							$$ = Integer;
 						}
 					| VOID
 						{
-							$$ = (YYSTYPE)Void;
+							$$ = Void;
 						}
 					;
 
-func_declaration	: type_specifier ID LPAREN params RPAREN compound_stmt
+func_declaration	: type_specifier ID LPAREN
+						{
+							/* the line of the function name : the
+							   token after LPAREN is never an ID */
+							$<val>$ = savedLineNo;
+						}
+					  params RPAREN compound_stmt
 					  	{
-							/* get string from stack. */
-							StackNode *tokenNode = PopStack(&top);
-							savedName = copyString(tokenNode->token);
-							free(tokenNode);
-
 							/* create new node. */
 							$$ = newDeclareNode(IdDec);
 
-							$$->attr.name = copyString(savedName);
-                            $$->type = (Type)$1;
-							free(savedName);
+							NODE($$)->attr.name = nameIndex($2);
+                            NODE($$)->type = (Type)$1;
+							/* the function is on the line of its name,
+							   not of its closing curly brace */
+							NODE($$)->lineno = $<val>4;
 
-							$$->child[0] = $4;
-							$$->child[1] = $6;
+							NODE($$)->child[0] = $5;
+							NODE($$)->child[1] = $7;
 						}
 					;
 
 params				: param_list
 						{
-							$$ = $1;
+							$$ = closeList($1);
 						}
 					| VOID
 						{
-							$$ = NULL;
+							$$ = 0;
 						}
 					;
 
 param_list			: param_list COMMA param
 						{
-							YYSTYPE node = $1;
-
-							if (node == NULL)
-								$$ = $3;
-							else
-							{
-								while (node->sibling != NULL)
-									node = node->sibling;
-
-								node->sibling = $3;
-
-								$$ = $1;
-							}
+							$$ = appendList($1, $3);
 						}
 					| param
 						{
-							$$ = $1;
+							$$ = appendList(0, $1);
 						}
 					;
 
@@ -174,23 +159,15 @@ param				: type_specifier ID
 						{
 							$$ = newDeclareNode(ParamDec);
 
-							StackNode *tokenNode = PopStack(&top);
-
-							$$->attr.name = copyString(tokenNode->token);
-                            $$->type = (Type)$1;
-
-							free(tokenNode);
+							NODE($$)->attr.name = nameIndex($2);
+                            NODE($$)->type = (Type)$1;
 						}
 					| type_specifier ID LBRACE RBRACE
 						{
 							$$ = newDeclareNode(ParamDec);
 
-							StackNode *tokenNode = PopStack(&top);
-
-							$$->attr.name = copyString(tokenNode->token);
-                            $$->type = IntegerArray;
-
-							free(tokenNode);
+							NODE($$)->attr.name = nameIndex($2);
+                            NODE($$)->type = IntegerArray;
 						}
 					;
 
@@ -198,57 +175,34 @@ compound_stmt		: LCURLY local_declarations statement_list RCURLY
 						{
 							$$ = newStmtNode(CompoundStmt);
 
-							$$->child[0] = $2;
-							$$->child[1] = $3;
+							NODE($$)->child[0] = closeList($2);
+							NODE($$)->child[1] = closeList($3);
 
-							if ($$->child[0] == NULL)
+							if (NODE($$)->child[0] == 0)
 							{
-								$$->child[0] = newEmptyNode();
+								NodeIndex empty = newEmptyNode();
+								NODE($$)->child[0] = empty;
 							}
 						}
 					;
 
 local_declarations	: /* empty */
 						{
-							$$ = NULL;
+							$$ = 0;
 						}
                     | local_declarations var_declaration
 						{
-							YYSTYPE node = $1;
-
-							if (node == NULL)
-								$$ = $2;
-							else
-							{
-								while (node->sibling != NULL)
-									node = node->sibling;
-
-								node->sibling = $2;
-
-								$$ = $1;
-							}
+							$$ = appendList($1, $2);
 						}
 					;
 
 statement_list		: statement_list statement
 						{
-							YYSTYPE node = $1;
-
-							if (node == NULL)
-								$$ = $2;
-							else
-							{
-								while (node->sibling != NULL)
-									node = node->sibling;
-
-								node->sibling = $2;
-
-								$$ = $1;
-							}
+							$$ = appendList($1, $2);
 						}
 					| /* empty */
 						{
-							$$ = NULL;
+							$$ = 0;
 						}
 					;
 
@@ -280,7 +234,7 @@ expression_stmt		: expression SEMI
 						}
 					| SEMI
 						{
-							$$ = NULL;
+							$$ = 0;
 						}
 					;
 
@@ -288,16 +242,16 @@ selection_stmt		: IF LPAREN expression RPAREN statement
 						{
 							$$ = newStmtNode(SelectionStmt);
 
-							$$->child[0] = $3;
-							$$->child[1] = $5;
+							NODE($$)->child[0] = $3;
+							NODE($$)->child[1] = $5;
 						}
 					| IF LPAREN expression RPAREN statement ELSE statement
 						{
 							$$ = newStmtNode(SelectionStmt);
 
-							$$->child[0] = $3;
-							$$->child[1] = $5;
-							$$->child[2] = $7;
+							NODE($$)->child[0] = $3;
+							NODE($$)->child[1] = $5;
+							NODE($$)->child[2] = $7;
 						}
 					;
 
@@ -305,8 +259,8 @@ iteration_stmt		: WHILE LPAREN expression RPAREN statement
 						{
 							$$ = newStmtNode(IterationStmt);
 
-							$$->child[0] = $3;
-							$$->child[1] = $5;
+							NODE($$)->child[0] = $3;
+							NODE($$)->child[1] = $5;
 						}
 					;
 
@@ -318,7 +272,7 @@ return_stmt			: RETURN SEMI
 						{
 							$$ = newStmtNode(ReturnStmt);
 
-							$$->child[0] = $2;
+							NODE($$)->child[0] = $2;
 						}
 					;
 
@@ -326,9 +280,9 @@ expression			: var ASSIGN expression
 						{
 							$$ = newExpNode(OpExp);
 
-							$$->child[0] = $1;
-							$$->attr.op = ASSIGN;
-							$$->child[1] = $3;
+							NODE($$)->child[0] = $1;
+							NODE($$)->attr.op = ASSIGN;
+							NODE($$)->child[1] = $3;
 						}
 					| simple_expression
 						{
@@ -340,20 +294,14 @@ var					: ID
 						{
 							$$ = newExpNode(IdExp);
 
-							StackNode *tokenNode = PopStack(&top);
-
-							$$->attr.name = copyString(tokenNode->token);
-
-							free(tokenNode);
+							NODE($$)->attr.name = nameIndex($1);
 						}
 					| ID LBRACE expression RBRACE
 						{
 							$$ = newExpNode(IdExp);
-							StackNode *tokenNode = PopStack(&top);
-							$$->attr.name = copyString(tokenNode->token);
-							free(tokenNode);
+							NODE($$)->attr.name = nameIndex($1);
 
-							$$->child[0] = $3;
+							NODE($$)->child[0] = $3;
 						}
 					;
 
@@ -361,9 +309,9 @@ simple_expression	: add_expression relop add_expression
 						{
 							$$ = newExpNode(OpExp);
 
-							$$->attr.op = (long)$2;
-							$$->child[0] = $1;
-							$$->child[1] = $3;
+							NODE($$)->attr.op = $2;
+							NODE($$)->child[0] = $1;
+							NODE($$)->child[1] = $3;
 						}
 					| add_expression
 						{
@@ -371,21 +319,21 @@ simple_expression	: add_expression relop add_expression
 						}
 					;
 
-relop				: GE {$$ = (YYSTYPE)GE;}
-					| GT {$$ = (YYSTYPE)GT;}
-					| LE {$$ = (YYSTYPE)LE;}
-					| LT {$$ = (YYSTYPE)LT;}
-					| EQ {$$ = (YYSTYPE)EQ;}
-					| NE {$$ = (YYSTYPE)NE;}
+relop				: GE {$$ = GE;}
+					| GT {$$ = GT;}
+					| LE {$$ = LE;}
+					| LT {$$ = LT;}
+					| EQ {$$ = EQ;}
+					| NE {$$ = NE;}
 					;
 
 add_expression		: add_expression addop term
 						{
 							$$ = newExpNode(OpExp);
 
-							$$->attr.op = (long)$2;
-							$$->child[0] = $1;
-							$$->child[1] = $3;
+							NODE($$)->attr.op = $2;
+							NODE($$)->child[0] = $1;
+							NODE($$)->child[1] = $3;
 						}
 					| term
 						{
@@ -393,17 +341,17 @@ add_expression		: add_expression addop term
 						}
 					;
 
-addop				: PLUS {$$ = (YYSTYPE)PLUS;}
-					| MINUS {$$ = (YYSTYPE)MINUS;}
+addop				: PLUS {$$ = PLUS;}
+					| MINUS {$$ = MINUS;}
 					;
 
 term				: term mulop factor
 						{
 							$$ = newExpNode(OpExp);
 
-							$$->attr.op = (long)$2;
-							$$->child[0] = $1;
-							$$->child[1] = $3;
+							NODE($$)->attr.op = $2;
+							NODE($$)->child[0] = $1;
+							NODE($$)->child[1] = $3;
 						}
 					| factor
 						{
@@ -411,8 +359,8 @@ term				: term mulop factor
 						}
 					;
 
-mulop				: TIMES {$$ = (YYSTYPE)TIMES;}
-					| OVER {$$ = (YYSTYPE)OVER;}
+mulop				: TIMES {$$ = TIMES;}
+					| OVER {$$ = OVER;}
 					;
 
 factor				: LPAREN expression RPAREN
@@ -431,11 +379,7 @@ factor				: LPAREN expression RPAREN
 						{
 							$$ = newExpNode(ConstExp);
 
-							StackNode *tokenNode = PopStack(&top);
-
-							$$->attr.val = atoi(tokenNode->token);
-
-							free(tokenNode);
+							NODE($$)->attr.val = $1;
 						}
 					;
 
@@ -443,47 +387,30 @@ call				: ID LPAREN args RPAREN
 						{
 							$$ = newExpNode(IdExp);
 
-							StackNode *tokenNode = PopStack(&top);
-							$$->attr.name = copyString(tokenNode->token);
-                            $$->type = Func;
-							free(tokenNode);
+							NODE($$)->attr.name = nameIndex($1);
+                            NODE($$)->type = Func;
 
-							$$->child[0] = $3;
+							NODE($$)->child[0] = $3;
 						}
 					;
 
 args				: args_list
 						{
-							$$ = $1;
+							$$ = closeList($1);
 						}
 					| /* empty */
 						{
-                            $$ = NULL;
+                            $$ = 0;
 						}
 					;
 
 args_list			: args_list COMMA expression
 						{
-							YYSTYPE node = $1;
-
-							if (node == NULL)
-							{
-								$$ = $3;
-							}
-							else
-							{
-								while (node->sibling != NULL)
-								{
-									node = node->sibling;
-								}
-
-								node->sibling = $3;
-								$$ = $1;
-							}
+							$$ = appendList($1, $3);
 						}
 					| expression
 						{
-							$$ = $1;
+							$$ = appendList(0, $1);
 						}
 					;
 
@@ -494,7 +421,7 @@ int yyerror(char * message)
 {
 	fprintf(listing,"Syntax error at line %d: %s\n",lineno,message);
 	fprintf(listing,"Current token: ");
-	printToken(yychar,tokenString);
+	printToken(yychar,tokenString,tokenLength);
 	Error = TRUE;
 	
 	return 0;
@@ -505,12 +432,50 @@ int yyerror(char * message)
  */
 static int yylex(void)
 {
-	return getToken();
+	int token = getToken();
+	if (token == ID)
+		savedLineNo = lineno;
+	return token;
+}
+
+/* Function appendList appends node t, if any, to the
+ * circular list ending at list, and returns its new end
+ */
+static NodeIndex appendList(NodeIndex list, NodeIndex t)
+{
+	if (t == 0)
+		return list;
+
+	if (list == 0)
+		NODE(t)->sibling = t;
+	else
+	{
+		NODE(t)->sibling = NODE(list)->sibling;
+		NODE(list)->sibling = t;
+	}
+
+	return t;
+}
+
+/* Function closeList ends the circular list ending at
+ * list, and returns its first node
+ */
+static NodeIndex closeList(NodeIndex list)
+{
+	NodeIndex first;
+
+	if (list == 0)
+		return 0;
+
+	first = NODE(list)->sibling;
+	NODE(list)->sibling = 0;
+
+	return first;
 }
 
 TreeNode * parse(void)
 {
 	yyparse();
-	return savedTree;
+	return NODE(savedTree);
 }
 
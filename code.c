@@ -17,6 +17,46 @@ static int emitLoc = 0 ;
    emitBackup, and emitRestore */
 static int highEmitLoc = 0;
 
+/* source line and function of the current
+   instruction emission, and of each location
+   emitted so far (the line table) */
+static int curLine = 0;
+static char * curFunction = NULL;
+static int * lineTab = NULL;
+static char ** functionTab = NULL;
+static int tabSize = 0;
+
+/* variables entered by emitData, for the line table */
+typedef struct dataRec
+   { char * function;
+     char * name;
+     int loc;
+     int size;
+     struct dataRec * next;
+   } * DataList;
+static DataList dataList = NULL;
+static DataList dataTail = NULL;
+
+/* Procedure noteLine enters the current source
+ * line and function of location loc into the
+ * line table
+ */
+static void noteLine( int loc)
+{ int i;
+  if (loc >= tabSize)
+  { i = tabSize;
+    tabSize = (loc + 1) * 2;
+    lineTab = (int *) realloc(lineTab, tabSize * sizeof(int));
+    functionTab = (char **) realloc(functionTab, tabSize * sizeof(char *));
+    for ( ; i < tabSize; i++)
+    { lineTab[i] = 0;
+      functionTab[i] = NULL;
+    }
+  }
+  lineTab[loc] = curLine;
+  functionTab[loc] = curFunction;
+} /* noteLine */
+
 /* Procedure emitComment prints a comment line 
  * with comment c in the code file
  */
@@ -32,7 +72,8 @@ void emitComment( char * c )
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRO( char *op, int r, int s, int t, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d,%d ",emitLoc++,op,r,s,t);
+{ noteLine(emitLoc);
+  fprintf(code,"%3d:  %5s  %d,%d,%d ",emitLoc++,op,r,s,t);
   if (TraceCode) fprintf(code,"\t%s",c) ;
   fprintf(code,"\n") ;
   if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
@@ -47,12 +88,30 @@ void emitRO( char *op, int r, int s, int t, char *c)
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRM( char * op, int r, int d, int s, char *c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",emitLoc++,op,r,d,s);
+{ noteLine(emitLoc);
+  fprintf(code,"%3d:  %5s  %d,%d(%d) ",emitLoc++,op,r,d,s);
   if (TraceCode) fprintf(code,"\t%s",c) ;
   fprintf(code,"\n") ;
   if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
 } /* emitRM */
 
+/* Procedure emitRX emits an indexed register-to-memory
+ * TM instruction, addressing mem(d+reg(s)-reg(t))
+ * op = the opcode
+ * r = target register
+ * d = the offset
+ * s = the base register
+ * t = the index register
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitRX( char * op, int r, int d, int s, int t, char *c)
+{ noteLine(emitLoc);
+  fprintf(code,"%3d:  %5s  %d,%d(%d,%d) ",emitLoc++,op,r,d,s,t);
+  if (TraceCode) fprintf(code,"\t%s",c) ;
+  fprintf(code,"\n") ;
+  if (highEmitLoc < emitLoc)  highEmitLoc = emitLoc ;
+} /* emitRX */
+
 /* Function emitSkip skips "howMany" code
  * locations for later backpatch. It also
  * returns the current code position
@@ -88,10 +147,92 @@ void emitRestore(void)
  * c = a comment to be printed if TraceCode is TRUE
  */
 void emitRM_Abs( char *op, int r, int a, char * c)
-{ fprintf(code,"%3d:  %5s  %d,%d(%d) ",
+{ noteLine(emitLoc);
+  fprintf(code,"%3d:  %5s  %d,%d(%d) ",
                emitLoc,op,r,a-(emitLoc+1),pc);
   ++emitLoc ;
   if (TraceCode) fprintf(code,"\t%s",c) ;
   fprintf(code,"\n") ;
   if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
 } /* emitRM_Abs */
+
+/* Procedure emitRB_Abs converts an absolute reference 
+ * to a pc-relative reference when emitting a
+ * register-register compare-and-branch TM instruction
+ * op = the opcode
+ * r = 1st compared register
+ * s = 2nd compared register
+ * a = the absolute location to branch to
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitRB_Abs( char *op, int r, int s, int a, char * c)
+{ noteLine(emitLoc);
+  fprintf(code,"%3d:  %5s  %d,%d,%d ",
+               emitLoc,op,r,s,a-(emitLoc+1));
+  ++emitLoc ;
+  if (TraceCode) fprintf(code,"\t%s",c) ;
+  fprintf(code,"\n") ;
+  if (highEmitLoc < emitLoc) highEmitLoc = emitLoc ;
+} /* emitRB_Abs */
+
+/* Function emitLine sets the source line of the
+ * instructions emitted from now on, and returns
+ * the previous one, so that it can be restored
+ */
+int emitLine( int lineno)
+{ int previous = curLine;
+  curLine = lineno;
+  return previous;
+} /* emitLine */
+
+/* Procedure emitFunction sets the function of the
+ * instructions emitted from now on (NULL outside
+ * of functions)
+ */
+void emitFunction( char * name)
+{ curFunction = name;
+} /* emitFunction */
+
+/* Procedure emitData enters a variable of the
+ * current function (a global one outside of
+ * functions) into the line table
+ * name = the variable name
+ * loc = its location, relative to fp or gp
+ * size = its number of words
+ */
+void emitData( char * name, int loc, int size)
+{ DataList d = (DataList) malloc(sizeof(struct dataRec));
+  d->function = curFunction;
+  d->name = name;
+  d->loc = loc;
+  d->size = size;
+  d->next = NULL;
+  if (dataTail == NULL) dataList = d;
+  else dataTail->next = d;
+  dataTail = d;
+} /* emitData */
+
+/* Procedure emitLineTable writes the line table
+ * of the emitted code to file f: one line
+ * "first last lineno function" for each range of
+ * locations of the same source line and function,
+ * then one line "var function name loc size"
+ * for each variable entered by emitData
+ */
+void emitLineTable( FILE * f)
+{ int first, last;
+  DataList d;
+  fprintf(f,"* C-Minus line table: first last lineno function\n");
+  for (first = 0; first < highEmitLoc && first < tabSize; first = last + 1)
+  { last = first;
+    while ((last + 1 < highEmitLoc) && (last + 1 < tabSize)
+           && (lineTab[last + 1] == lineTab[first])
+           && (functionTab[last + 1] == functionTab[first]))
+      last++;
+    fprintf(f,"%d %d %d %s\n",first,last,lineTab[first],
+            functionTab[first] == NULL ? "-" : functionTab[first]);
+  }
+  for (d = dataList; d != NULL; d = d->next)
+    fprintf(f,"var %s %s %d %d\n",
+            d->function == NULL ? "-" : d->function,d->name,d->loc,d->size);
+} /* emitLineTable */
@@ -65,6 +65,17 @@ void emitRO( char *op, int r, int s, int t, char *c);
  */
 void emitRM( char * op, int r, int d, int s, char *c);
 
+/* Procedure emitRX emits an indexed register-to-memory
+ * TM instruction, addressing mem(d+reg(s)-reg(t))
+ * op = the opcode
+ * r = target register
+ * d = the offset
+ * s = the base register
+ * t = the index register
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitRX( char * op, int r, int d, int s, int t, char *c);
+
 /* Function emitSkip skips "howMany" code
  * locations for later backpatch. It also
  * returns the current code position
@@ -92,4 +103,45 @@ void emitRestore(void);
  */
 void emitRM_Abs( char *op, int r, int a, char * c);
 
+/* Procedure emitRB_Abs converts an absolute reference 
+ * to a pc-relative reference when emitting a
+ * register-register compare-and-branch TM instruction
+ * op = the opcode
+ * r = 1st compared register
+ * s = 2nd compared register
+ * a = the absolute location to branch to
+ * c = a comment to be printed if TraceCode is TRUE
+ */
+void emitRB_Abs( char *op, int r, int s, int a, char * c);
+
+/* Function emitLine sets the source line of the
+ * instructions emitted from now on, and returns
+ * the previous one, so that it can be restored
+ */
+int emitLine( int lineno);
+
+/* Procedure emitFunction sets the function of the
+ * instructions emitted from now on (NULL outside
+ * of functions)
+ */
+void emitFunction( char * name);
+
+/* Procedure emitData enters a variable of the
+ * current function (a global one outside of
+ * functions) into the line table
+ * name = the variable name
+ * loc = its location, relative to fp or gp
+ * size = its number of words
+ */
+void emitData( char * name, int loc, int size);
+
+/* Procedure emitLineTable writes the line table
+ * of the emitted code to file f: one line
+ * "first last lineno function" for each range of
+ * locations of the same source line and function,
+ * then one line "var function name loc size"
+ * for each variable entered by emitData
+ */
+void emitLineTable( FILE * f);
+
 #endif
@@ -52,7 +52,8 @@
  */
 typedef int TokenType; 
 
-extern FILE* source; /* source code text file */
+extern const char* sourceText; /* source code text, mapped */
+extern long sourceLength; /* length of sourceText */
 extern FILE* listing; /* listing output text file */
 extern FILE* code; /* code text file for TM simulator */
 
@@ -72,30 +73,50 @@ typedef enum {Void, Integer, IntegerArray, Func, VoidArray} Type;
 
 #define MAXCHILDREN 3
 
+/* the nodes of the syntax tree are kept in one array,
+ * treeNodes, and refer to each other by their index in
+ * it : index 0 is no node. The names of the tree are
+ * kept in a side table, treeNames, of interned names.
+ */
+typedef unsigned int NodeIndex;
+typedef unsigned int NameIndex;
+
 typedef struct treeNode
 {
-	struct treeNode * child[MAXCHILDREN];
-	struct treeNode * sibling;
+	NodeIndex child[MAXCHILDREN];
+	NodeIndex sibling;
 	int lineno;
-	NodeKind nodekind;
+	unsigned char nodekind; /* NodeKind */
 	
 	union
 	{
-		StmtKind stmt;
-		ExpKind exp;
-		DeclareKind declaration;
+		unsigned char stmt; /* StmtKind */
+		unsigned char exp; /* ExpKind */
+		unsigned char declaration; /* DeclareKind */
 	} kind;
+	
+	unsigned char type; /* Type */
     
 	union
 	{
 		TokenType op;
 		int val;
-		char * name;
+		NameIndex name;
 	} attr;
-	
-	Type type;
 } TreeNode;
 
+extern TreeNode * treeNodes;
+extern char ** treeNames;
+
+/* NODE(i) is the node of index i, or NULL for 0 : it
+ * may move when a node is created, up to the end of
+ * parsing
+ */
+#define NODE(i) ((i) == 0 ? NULL : &treeNodes[(i)])
+
+/* NAME(t) is the interned name of node t */
+#define NAME(t) (treeNames[(t)->attr.name])
+
 /**************************************************/
 /***********   Flags for tracing       ************/
 /**************************************************/
@@ -130,4 +151,28 @@ extern int TraceCode;
 
 /* Error = TRUE prevents further passes if an error occurs */
 extern int Error; 
+
+/**************************************************/
+/***********   Flags for optimization  ************/
+/**************************************************/
+
+/* MemoSize > 0 causes pure recursive functions
+ * returning int to be memoized in TM code, with
+ * a table of MemoSize entries per function kept
+ * in data memory after the global variables
+ */
+extern int MemoSize;
+
+/* MemoEvict = TRUE causes a new result to replace
+ * the one in its table entry; FALSE keeps the
+ * first result stored in each entry
+ */
+extern int MemoEvict;
+
+/* LexThreads > 0 causes the whole source text to be
+ * scanned into tokens before parsing, split into at
+ * most LexThreads parts scanned in parallel (scan.c
+ * only : the flex scanner rejects it)
+ */
+extern int LexThreads;
 #endif
@@ -0,0 +1,524 @@
+/****************************************************/
+/* File: libtm.c                                    */
+/* The TM ("Tiny Machine") computer as a library    */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "libtm.h"
+
+char * opCodeTab[]
+        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV","????",
+            /* RR opcodes */
+           "LD","ST","????", /* RM opcodes */
+           "LDA","LDC","MULI","DIVI","JLT","JLE","JGT","JGE","JEQ","JNE","????",
+           /* RA opcodes */
+           "BLT","BLE","BGT","BGE","BEQ","BNE","????",
+           /* RB opcodes */
+           "LDX","STX","????"  /* RX opcodes */
+          };
+
+char * stepResultTab[]
+        = {"OK","Halted","Instruction Memory Fault",
+           "Data Memory Fault","Division by 0",
+           "End of Input","Instruction Budget Exhausted",
+           "Time Limit Exceeded"
+          };
+
+/* perfect hash of the opcode names : the opcode of a
+   name w of n letters is at opHash[(w[0] + 19*w[1] +
+   4*w[n-1] + n) & 63], or there is no such opcode */
+static const int opHash[64]
+        = {-1    , opJLT , -1    , -1    , opMULI, opJLE , -1    , -1    ,
+           -1    , -1    , opDIV , -1    , -1    , opIN  , -1    , opMUL ,
+           -1    , -1    , -1    , -1    , -1    , -1    , -1    , opDIVI,
+           -1    , -1    , opBGT , -1    , -1    , -1    , opBGE , opLDA ,
+           opADD , opST  , opJGT , opBNE , -1    , -1    , opJGE , opLDC ,
+           opBEQ , -1    , opLD  , opJNE , -1    , opSUB , -1    , opHALT,
+           opJEQ , opOUT , opSTX , -1    , -1    , -1    , -1    , -1    ,
+           -1    , opBLT , -1    , opLDX , -1    , opBLE , -1    , -1
+          };
+
+/********************************************/
+int opClass( int c )
+{ if      ( c <= opRRLim) return ( opclRR );
+  else if ( c <= opRMLim) return ( opclRM );
+  else if ( c <= opRALim) return ( opclRA );
+  else if ( c <= opRBLim) return ( opclRB );
+  else                    return ( opclRX );
+} /* opClass */
+
+/********************************************/
+/* the loader scans the text in one pass,   */
+/* with p at the next character and end at  */
+/* the end of the text. Blanks do not       */
+/* include the end of line.                 */
+#define isBlank(c) (((c) == ' ') || ((c) == '\t') || ((c) == '\r') \
+                    || ((c) == '\f') || ((c) == '\v'))
+
+static const char * skipBlanks ( const char * p, const char * end )
+{ while ((p < end) && isBlank(*p)) p++ ;
+  return p ;
+} /* skipBlanks */
+
+/********************************************/
+/* number with signs, possibly a sum, as    */
+/* in "-1" or "3+-2"                        */
+static int scanNum ( const char ** pp, const char * end, int * num )
+{ const char * p = *pp ;
+  int sign, term ;
+  int temp = FALSE ;
+  *num = 0 ;
+  do
+  { sign = 1 ;
+    while (((p = skipBlanks(p, end)) < end) && ((*p == '+') || (*p == '-')))
+    { temp = FALSE ;
+      if (*p == '-') sign = - sign ;
+      p++ ;
+    }
+    term = 0 ;
+    p = skipBlanks(p, end) ;
+    while ((p < end) && isdigit((unsigned char) *p))
+    { temp = TRUE ;
+      term = term * 10 + (*p - '0') ;
+      p++ ;
+    }
+    *num = *num + (term * sign) ;
+  } while (((p = skipBlanks(p, end)) < end) && ((*p == '+') || (*p == '-'))) ;
+  *pp = p ;
+  return temp ;
+} /* scanNum */
+
+/********************************************/
+static int scanCh ( const char ** pp, const char * end, char c )
+{ const char * p = skipBlanks(*pp, end) ;
+  if ((p < end) && (*p == c))
+  { *pp = p + 1 ;
+    return TRUE ;
+  }
+  *pp = p ;
+  return FALSE ;
+} /* scanCh */
+
+/********************************************/
+static int scanReg ( const char ** pp, const char * end, int * r )
+{ return scanNum(pp, end, r) && (*r >= 0) && (*r < NO_REGS) ;
+} /* scanReg */
+
+/********************************************/
+/* opcode of the name at p, by the perfect  */
+/* hash : -1 if there is no name, or        */
+/* opRXLim if it is no opcode               */
+static int scanOp ( const char ** pp, const char * end )
+{ const char * w = skipBlanks(*pp, end) ;
+  const char * p = w ;
+  int n, op ;
+  while ((p < end) && isalnum((unsigned char) *p)) p++ ;
+  *pp = p ;
+  n = p - w ;
+  if (n == 0) return -1 ;
+  if ((n < 2) || (n > 4)) return opRXLim ;
+  op = opHash[(w[0] + 19 * w[1] + 4 * w[n-1] + n) & 63] ;
+  if ((op < 0) || (strncmp(opCodeTab[op], w, n) != 0)
+      || (opCodeTab[op][n] != '\0'))
+    return opRXLim ;
+  return op ;
+} /* scanOp */
+
+/********************************************/
+static int error( TM_VM * vm, char * msg, int lineNo, int instNo)
+{ if (instNo >= 0)
+    sprintf(vm->error, "Line %d (Instruction %d)   %s", lineNo, instNo, msg);
+  else
+    sprintf(vm->error, "Line %d   %s", lineNo, msg);
+  return FALSE;
+} /* error */
+
+/********************************************/
+TM_VM * tm_new ( void )
+{ TM_VM * vm = (TM_VM *) calloc(1, sizeof(TM_VM)) ;
+  if (vm != NULL) tm_reset(vm) ;
+  return vm ;
+} /* tm_new */
+
+/********************************************/
+void tm_free ( TM_VM * vm )
+{ free(vm) ;
+} /* tm_free */
+
+/********************************************/
+void tm_reset ( TM_VM * vm )
+{ int loc, regNo;
+  if ((vm->dSize <= 0) || (vm->dSize > DADDR_SIZE))
+      vm->dSize = DADDR_SIZE ;
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+      vm->reg[regNo] = 0 ;
+  vm->dMem[0] = vm->dSize - 1 ;
+  for (loc = 1 ; loc < DADDR_SIZE ; loc++)
+      vm->dMem[loc] = 0 ;
+  vm->block = 0 ;
+  vm->used = 0 ;
+  vm->fuel = 0 ;
+  vm->deadline = 0 ;
+  vm->jumps = 0 ;
+} /* tm_reset */
+
+/********************************************/
+int tm_load_from_memory ( TM_VM * vm, const char * text, long length )
+{ int op;
+  int arg1, arg2, arg3, arg4;
+  int loc, lineNo, size;
+  const char * p = text ;
+  const char * end = text + length ;
+  const char * name = NULL ;  /* pending "* Function: " comment */
+  int nameLen = 0 ;
+  char * label ;
+
+  vm->dSize = DADDR_SIZE ;
+  tm_reset(vm) ;
+  vm->error[0] = '\0' ;
+  for (loc = 0 ; loc < IADDR_SIZE ; loc++)
+  { vm->iMem[loc].iop = opHALT ;
+    vm->iMem[loc].iarg1 = 0 ;
+    vm->iMem[loc].iarg2 = 0 ;
+    vm->iMem[loc].iarg3 = 0 ;
+    vm->iMem[loc].iarg4 = 0 ;
+  }
+  for (lineNo = 1 ; (p = skipBlanks(p, end)) < end ; lineNo++)
+  { if (*p == '\n')
+    { p++ ;
+      continue ;
+    }
+    if (*p == '*')
+    { if ((end - p > 12) && (strncmp(p, "* Function: ", 12) == 0))
+      { name = p + 12 ;
+        while ((p < end) && (*p != '\n')) p++ ;
+        nameLen = p - name ;
+        while ((nameLen > 0) && isspace((unsigned char) name[nameLen-1]))
+          nameLen-- ;
+      }
+      /* data memory the program needs, if it is known : a
+         larger bound is cut to DADDR_SIZE, and the accesses
+         past it stop the run with srDMEM_ERR */
+      else if ((end - p > 15) && (strncmp(p, "* Data memory: ", 15) == 0))
+      { p += 15 ;
+        if (scanNum(&p, end, &size) && (size > DADDR_SIZE))
+          size = DADDR_SIZE ;
+        if (size > 0) vm->dSize = size ;
+        if ((p = memchr(p, '\n', end - p)) == NULL)
+          p = end ;
+      }
+      else if ((p = memchr(p, '\n', end - p)) == NULL)
+        p = end ;
+      p++ ;
+      continue ;
+    }
+    if (! scanNum(&p, end, &loc))
+      return error(vm, "Bad location", lineNo,-1);
+    if ((loc < 0) || (loc >= IADDR_SIZE))
+      return error(vm, "Location too large",lineNo,loc);
+    if (! scanCh(&p, end, ':'))
+      return error(vm, "Missing colon", lineNo,loc);
+    op = scanOp(&p, end) ;
+    if (op < 0)
+      return error(vm, "Missing opcode", lineNo,loc);
+    if (op == opRXLim)
+      return error(vm, "Illegal opcode", lineNo,loc);
+    arg4 = 0 ;
+    switch ( opClass(op) )
+    { case opclRR :
+      /***********************************/
+      if ( ! scanReg(&p, end, &arg1) )
+          return error(vm, "Bad first register", lineNo,loc);
+      if ( ! scanCh(&p, end, ','))
+          return error(vm, "Missing comma", lineNo, loc);
+      if ( ! scanReg(&p, end, &arg2) )
+          return error(vm, "Bad second register", lineNo, loc);
+      if ( ! scanCh(&p, end, ','))
+          return error(vm, "Missing comma", lineNo,loc);
+      if ( ! scanReg(&p, end, &arg3) )
+          return error(vm, "Bad third register", lineNo,loc);
+      break;
+
+      case opclRM :
+      case opclRA :
+      /***********************************/
+      if ( ! scanReg(&p, end, &arg1) )
+          return error(vm, "Bad first register", lineNo,loc);
+      if ( ! scanCh(&p, end, ','))
+          return error(vm, "Missing comma", lineNo,loc);
+      if (! scanNum (&p, end, &arg2))
+          return error(vm, "Bad displacement", lineNo,loc);
+      if ( ! scanCh(&p, end, '(') && ! scanCh(&p, end, ',') )
+          return error(vm, "Missing LParen", lineNo,loc);
+      if ( ! scanReg(&p, end, &arg3) )
+          return error(vm, "Bad second register", lineNo,loc);
+      break;
+
+      case opclRB :
+      /***********************************/
+      if ( ! scanReg(&p, end, &arg1) )
+          return error(vm, "Bad first register", lineNo,loc);
+      if ( ! scanCh(&p, end, ','))
+          return error(vm, "Missing comma", lineNo,loc);
+      if ( ! scanReg(&p, end, &arg2) )
+          return error(vm, "Bad second register", lineNo,loc);
+      if ( ! scanCh(&p, end, ','))
+          return error(vm, "Missing comma", lineNo,loc);
+      if (! scanNum (&p, end, &arg3))
+          return error(vm, "Bad displacement", lineNo,loc);
+      break;
+
+      case opclRX :
+      /***********************************/
+      if ( ! scanReg(&p, end, &arg1) )
+          return error(vm, "Bad first register", lineNo,loc);
+      if ( ! scanCh(&p, end, ','))
+          return error(vm, "Missing comma", lineNo,loc);
+      if (! scanNum (&p, end, &arg2))
+          return error(vm, "Bad displacement", lineNo,loc);
+      if ( ! scanCh(&p, end, '('))
+          return error(vm, "Missing LParen", lineNo,loc);
+      if ( ! scanReg(&p, end, &arg3) )
+          return error(vm, "Bad second register", lineNo,loc);
+      if ( ! scanCh(&p, end, ','))
+          return error(vm, "Missing comma", lineNo,loc);
+      if ( ! scanReg(&p, end, &arg4) )
+          return error(vm, "Bad third register", lineNo,loc);
+      break;
+    }
+    vm->iMem[loc].iop = op;
+    vm->iMem[loc].iarg1 = arg1;
+    vm->iMem[loc].iarg2 = arg2;
+    vm->iMem[loc].iarg3 = arg3;
+    vm->iMem[loc].iarg4 = arg4;
+    if (name != NULL)
+    { if ((vm->label != NULL) && ((label = malloc(nameLen + 1)) != NULL))
+      { memcpy(label, name, nameLen) ;
+        label[nameLen] = '\0' ;
+        vm->label(vm, loc, label) ;
+        free(label) ;
+      }
+      name = NULL ;
+    }
+    /* the rest of the line is a comment */
+    if ((p = memchr(p, '\n', end - p)) == NULL)
+      p = end ;
+    p++ ;
+  }
+  /* data memory of the program */
+  tm_reset(vm) ;
+  return TRUE;
+} /* tm_load_from_memory */
+
+/********************************************/
+int tm_load_file ( TM_VM * vm, const char * fileName )
+{ struct stat st ;
+  void * text ;
+  int fd, ok ;
+
+  fd = open(fileName, O_RDONLY) ;
+  if ((fd < 0) || (fstat(fd, &st) != 0))
+  { sprintf(vm->error, "file '%.100s' not found", fileName) ;
+    if (fd >= 0) close(fd) ;
+    return FALSE ;
+  }
+  if (st.st_size == 0)
+  { close(fd) ;
+    return tm_load_from_memory(vm, "", 0) ;
+  }
+  text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) ;
+  close(fd) ;
+  if (text == MAP_FAILED)
+  { sprintf(vm->error, "file '%.100s' cannot be read", fileName) ;
+    return FALSE ;
+  }
+  madvise(text, st.st_size, MADV_SEQUENTIAL) ;
+  ok = tm_load_from_memory(vm, (const char *) text, (long) st.st_size) ;
+  munmap(text, st.st_size) ;
+  return ok ;
+} /* tm_load_file */
+
+/********************************************/
+static double wallClock (void)
+{ struct timespec ts ;
+  clock_gettime(CLOCK_MONOTONIC, &ts) ;
+  return ts.tv_sec + ts.tv_nsec * 1e-9 ;
+} /* wallClock */
+
+/********************************************/
+void tm_budget ( TM_VM * vm, long fuel, double seconds )
+{ vm->block = vm->reg[PC_REG] ;
+  vm->used = 0 ;
+  vm->fuel = fuel ;
+  vm->deadline = (seconds > 0) ? wallClock() + seconds : 0 ;
+  vm->jumps = 0 ;
+} /* tm_budget */
+
+/********************************************/
+long tm_executed ( TM_VM * vm )
+{ return vm->used + (vm->reg[PC_REG] - vm->block) ;
+} /* tm_executed */
+
+/********************************************/
+/* a jump was taken at pc : the run from    */
+/* vm->block to pc is charged to the        */
+/* budget, and the clock is read every      */
+/* 1024 backward jumps                      */
+static STEPRESULT endBlock ( TM_VM * vm, int pc )
+{ int target = vm->reg[PC_REG] ;
+  vm->used += pc - vm->block + 1 ;
+  vm->block = target ;
+  if ((vm->fuel > 0) && (vm->used >= vm->fuel))
+    return srFUEL ;
+  if ((vm->deadline > 0) && (target <= pc) && ((++vm->jumps & 1023) == 0)
+      && (wallClock() >= vm->deadline))
+    return srTIMEOUT ;
+  return srOKAY ;
+} /* endBlock */
+
+/********************************************/
+STEPRESULT tm_step ( TM_VM * vm )
+{ INSTRUCTION currentinstruction  ;
+  int * reg = vm->reg ;
+  int * dMem = vm->dMem ;
+  int pc  ;
+  int r,s,t,m  ;
+
+  pc = reg[PC_REG] ;
+  if ( (pc < 0) || (pc >= IADDR_SIZE)  )
+      return srIMEM_ERR ;
+  reg[PC_REG] = pc + 1 ;
+  currentinstruction = vm->iMem[ pc ] ;
+  switch (opClass(currentinstruction.iop) )
+  { case opclRR :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg2 ;
+      t = currentinstruction.iarg3 ;
+      break;
+
+    case opclRM :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg3 ;
+      m = currentinstruction.iarg2 + reg[s] ;
+      if ( (m < 0) || (m >= vm->dSize))
+         return srDMEM_ERR ;
+      if ( vm->memory != NULL )
+         vm->memory(vm, pc, m, currentinstruction.iop == opST) ;
+      break;
+
+    case opclRA :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg3 ;
+      m = currentinstruction.iarg2 + reg[s] ;
+      break;
+
+    case opclRB :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg2 ;
+      m = currentinstruction.iarg3 + reg[PC_REG] ;
+      break;
+
+    case opclRX :
+    /***********************************/
+      r = currentinstruction.iarg1 ;
+      s = currentinstruction.iarg3 ;
+      t = currentinstruction.iarg4 ;
+      m = currentinstruction.iarg2 + reg[s] - reg[t] ;
+      if ( (m < 0) || (m >= vm->dSize))
+         return srDMEM_ERR ;
+      if ( vm->memory != NULL )
+         vm->memory(vm, pc, m, currentinstruction.iop == opSTX) ;
+      break;
+  } /* case */
+
+  switch ( currentinstruction.iop)
+  { /* RR instructions */
+    case opHALT :
+    /***********************************/
+      return srHALT ;
+      /* break; */
+
+    case opIN :
+    /***********************************/
+      if ( (vm->in == NULL) || ! vm->in(vm, &reg[r]) )
+        return srIN_EOF ;
+      break;
+
+    case opOUT :
+      if ( vm->out != NULL ) vm->out(vm, reg[r]) ;
+      break;
+    case opADD :  reg[r] = reg[s] + reg[t] ;  break;
+    case opSUB :  reg[r] = reg[s] - reg[t] ;  break;
+    case opMUL :  reg[r] = reg[s] * reg[t] ;  break;
+
+    case opDIV :
+    /***********************************/
+      if ( reg[t] != 0 ) reg[r] = reg[s] / reg[t];
+      else return srZERODIVIDE ;
+      break;
+
+    /*************** RM instructions ********************/
+    case opLD :    reg[r] = dMem[m] ;  break;
+    case opST :    dMem[m] = reg[r] ;  break;
+
+    /*************** RA instructions ********************/
+    case opLDA :    reg[r] = m ; break;
+    case opLDC :    reg[r] = currentinstruction.iarg2 ;   break;
+    case opMULI :   reg[r] = reg[s] * currentinstruction.iarg2 ; break;
+
+    case opDIVI :
+    /***********************************/
+      if ( currentinstruction.iarg2 != 0 )
+        reg[r] = reg[s] / currentinstruction.iarg2;
+      else return srZERODIVIDE ;
+      break;
+
+    case opJLT :    if ( reg[r] <  0 ) reg[PC_REG] = m ; break;
+    case opJLE :    if ( reg[r] <=  0 ) reg[PC_REG] = m ; break;
+    case opJGT :    if ( reg[r] >  0 ) reg[PC_REG] = m ; break;
+    case opJGE :    if ( reg[r] >=  0 ) reg[PC_REG] = m ; break;
+    case opJEQ :    if ( reg[r] == 0 ) reg[PC_REG] = m ; break;
+    case opJNE :    if ( reg[r] != 0 ) reg[PC_REG] = m ; break;
+
+    /*************** RB instructions ********************/
+    case opBLT :    if ( reg[r] <  reg[s] ) reg[PC_REG] = m ; break;
+    case opBLE :    if ( reg[r] <= reg[s] ) reg[PC_REG] = m ; break;
+    case opBGT :    if ( reg[r] >  reg[s] ) reg[PC_REG] = m ; break;
+    case opBGE :    if ( reg[r] >= reg[s] ) reg[PC_REG] = m ; break;
+    case opBEQ :    if ( reg[r] == reg[s] ) reg[PC_REG] = m ; break;
+    case opBNE :    if ( reg[r] != reg[s] ) reg[PC_REG] = m ; break;
+
+    /*************** RX instructions ********************/
+    case opLDX :    reg[r] = dMem[m] ;  break;
+    case opSTX :    dMem[m] = reg[r] ;  break;
+
+    /* end of legal instructions */
+  } /* case */
+  if ( reg[PC_REG] != pc + 1 )
+    return endBlock(vm, pc) ;
+  return srOKAY ;
+} /* tm_step */
+
+/********************************************/
+STEPRESULT tm_run ( TM_VM * vm, long budget )
+{ STEPRESULT result ;
+  tm_budget(vm, budget, 0) ;
+  do
+    result = tm_step(vm) ;
+  while (result == srOKAY) ;
+  return result ;
+} /* tm_run */
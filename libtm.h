@@ -0,0 +1,190 @@
+/****************************************************/
+/* File: libtm.h                                    */
+/* The TM ("Tiny Machine") computer as a library    */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _LIBTM_H_
+#define _LIBTM_H_
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+/******* const *******/
+#define   IADDR_SIZE  1024 /* increase for large programs */
+#define   DADDR_SIZE  1024 /* increase for large programs */
+                           /* (programs may need less) */
+#define   NO_REGS 8
+#define   PC_REG  7
+
+/******* type  *******/
+
+typedef enum {
+   opclRR,     /* reg operands r,s,t */
+   opclRM,     /* reg r, mem d+s */
+   opclRA,     /* reg r, int d+s */
+   opclRB,     /* reg r, reg s, int d+pc */
+   opclRX      /* reg r, mem d+s-t */
+   } OPCLASS;
+
+typedef enum {
+   /* RR instructions */
+   opHALT,    /* RR     halt, operands are ignored */
+   opIN,      /* RR     read into reg(r); s and t are ignored */
+   opOUT,     /* RR     write from reg(r), s and t are ignored */
+   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
+   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
+   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
+   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
+   opRRLim,   /* limit of RR opcodes */
+
+   /* RM instructions */
+   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
+   opST,      /* RM     mem(d+reg(s)) = reg(r) */
+   opRMLim,   /* Limit of RM opcodes */
+
+   /* RA instructions */
+   opLDA,     /* RA     reg(r) = d+reg(s) */
+   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
+   opMULI,    /* RA     reg(r) = reg(s)*d */
+   opDIVI,    /* RA     reg(r) = reg(s)/d */
+   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
+   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
+   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
+   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
+   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
+   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+   opRALim,   /* Limit of RA opcodes */
+
+   /* RB instructions */
+   opBLT,     /* RB     if reg(r)<reg(s) then reg(7) = d+reg(7) */
+   opBLE,     /* RB     if reg(r)<=reg(s) then reg(7) = d+reg(7) */
+   opBGT,     /* RB     if reg(r)>reg(s) then reg(7) = d+reg(7) */
+   opBGE,     /* RB     if reg(r)>=reg(s) then reg(7) = d+reg(7) */
+   opBEQ,     /* RB     if reg(r)==reg(s) then reg(7) = d+reg(7) */
+   opBNE,     /* RB     if reg(r)!=reg(s) then reg(7) = d+reg(7) */
+   opRBLim,   /* Limit of RB opcodes */
+
+   /* RX instructions */
+   opLDX,     /* RX     reg(r) = mem(d+reg(s)-reg(t)) */
+   opSTX,     /* RX     mem(d+reg(s)-reg(t)) = reg(r) */
+   opRXLim    /* Limit of RX opcodes */
+   } OPCODE;
+
+typedef enum {
+   srOKAY,
+   srHALT,
+   srIMEM_ERR,
+   srDMEM_ERR,
+   srZERODIVIDE,
+   srIN_EOF,
+   srFUEL,
+   srTIMEOUT
+   } STEPRESULT;
+
+typedef struct {
+      int iop  ;
+      int iarg1  ;
+      int iarg2  ;
+      int iarg3  ;
+      int iarg4  ;
+   } INSTRUCTION;
+
+/* context of one TM : the program, the machine state,
+   the budget of the current run and the hooks of the
+   host. Several TMs can run in one process, and a
+   loaded TM can be copied to run the program again. */
+typedef struct tm_vm {
+      INSTRUCTION iMem [IADDR_SIZE] ;
+      int reg [NO_REGS] ;
+      int dMem [DADDR_SIZE] ;
+      int dSize ;       /* data memory of the program, as given by
+                           its "* Data memory: n" comment, at most
+                           DADDR_SIZE */
+
+      /* IN stores a value and returns TRUE, or returns
+         FALSE at the end of the input (srIN_EOF) */
+      int (* in) ( struct tm_vm * vm, int * value ) ;
+      /* OUT */
+      void (* out) ( struct tm_vm * vm, int value ) ;
+      /* every data memory access of LD, ST, LDX and STX
+         at pc, before it is made (NULL for none) */
+      void (* memory) ( struct tm_vm * vm, int pc, int addr, int store ) ;
+      /* "* Function: name" comment of the code file, for
+         the next instruction at loc (NULL for none) */
+      void (* label) ( struct tm_vm * vm, int loc, char * name ) ;
+      void * user ;     /* for the hooks */
+
+      /* budget of a run : instructions are counted per
+         straight-line run, when a jump is taken */
+      int block ;       /* first location of the current run */
+      long used ;       /* instructions executed before it */
+      long fuel ;       /* instruction budget, 0 if none */
+      double deadline ; /* wall-clock limit, 0 if none */
+      int jumps ;       /* backward jumps, to space out clock reads */
+
+      char error [128] ; /* message of a failed load */
+   } TM_VM;
+
+extern char * opCodeTab[] ;
+extern char * stepResultTab[] ;
+
+/* Function opClass returns the class of opcode c */
+int opClass ( int c ) ;
+
+/* Function tm_new allocates a TM without a program
+ * and with the hooks unset
+ */
+TM_VM * tm_new ( void ) ;
+
+/* Procedure tm_free frees a TM of tm_new */
+void tm_free ( TM_VM * vm ) ;
+
+/* Procedure tm_reset clears the registers and the
+ * data memory, as for a new execution of the program
+ */
+void tm_reset ( TM_VM * vm ) ;
+
+/* Function tm_load_from_memory loads the program in
+ * TM assembly text of length bytes, sizes the data
+ * memory and resets the machine. It returns FALSE,
+ * with a message in vm->error, if the text is not
+ * a program. A "* Data memory: n" bound above
+ * DADDR_SIZE is cut to DADDR_SIZE.
+ */
+int tm_load_from_memory ( TM_VM * vm, const char * text, long length ) ;
+
+/* Function tm_load_file loads the program of the
+ * code file fileName, mapped into memory, as
+ * tm_load_from_memory does
+ */
+int tm_load_file ( TM_VM * vm, const char * fileName ) ;
+
+/* Procedure tm_budget starts the budget of a run
+ * from the current pc : at most fuel instructions
+ * (0 for no limit) and seconds of wall-clock time
+ * (0 for no limit)
+ */
+void tm_budget ( TM_VM * vm, long fuel, double seconds ) ;
+
+/* Function tm_step executes one instruction */
+STEPRESULT tm_step ( TM_VM * vm ) ;
+
+/* Function tm_run executes instructions until a step
+ * result other than srOKAY, or until budget
+ * instructions (0 for no limit) have been executed
+ * (srFUEL)
+ */
+STEPRESULT tm_run ( TM_VM * vm, long budget ) ;
+
+/* Function tm_executed returns the number of
+ * instructions executed since the budget started
+ */
+long tm_executed ( TM_VM * vm ) ;
+
+#endif
@@ -26,13 +26,16 @@
 #include "analyze.h"
 #if !NO_CODE
 #include "cgen.h"
+#include "x86gen.h"
+#include "code.h"
 #endif
 #endif
 #endif
 
 /* allocate global variables */
 int lineno = 0;
-FILE * source;
+const char * sourceText;
+long sourceLength;
 FILE * listing;
 FILE * code;
 
@@ -45,14 +48,54 @@ int TraceCode = TRUE;
 
 int Error = FALSE;
 
+/* allocate and set optimization flags */
+int MemoSize = 0;
+int MemoEvict = TRUE;
+int LexThreads = 0;
+
 int main( int argc, char * argv[] )
 {
 	TreeNode * syntaxTree;
 	char pgm[120]; /* source code file name */
+	int x86 = FALSE; /* generate x86-64 code instead of TM code */
+
+	while (argc > 2 && argv[1][0] == '-')
+	{
+		if (strcmp(argv[1],"-x86") == 0)
+			x86 = TRUE;
+		/* memoize pure recursive functions */
+		else if (strcmp(argv[1],"-memo") == 0 && argc > 3
+				&& atoi(argv[2]) > 0)
+		{
+			MemoSize = atoi(argv[2]);
+			argv[2] = argv[0];
+			argv += 2;
+			argc -= 2;
+			continue;
+		}
+		else if (strcmp(argv[1],"-memo-keep") == 0)
+			MemoEvict = FALSE;
+		/* lex the source text ahead, on several threads */
+		else if (strcmp(argv[1],"-lex") == 0 && argc > 3
+				&& atoi(argv[2]) > 0)
+		{
+			LexThreads = atoi(argv[2]);
+			argv[2] = argv[0];
+			argv += 2;
+			argc -= 2;
+			continue;
+		}
+		else
+			break;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
 
   	if (argc != 2)
  	{
-		fprintf(stderr,"usage: %s <filename>\n",argv[0]);
+		fprintf(stderr,"usage: %s [-x86] [-memo <entries> [-memo-keep]] [-lex <threads>] <filename>\n",
+				argv[0]);
   		exit(1);
 	}
 
@@ -61,9 +104,7 @@ int main( int argc, char * argv[] )
    	if (strchr (pgm, '.') == NULL)
    		strcat(pgm,".tny");
 
-  	source = fopen(pgm,"r");
-
-  	if (source==NULL)
+  	if (! mapSource(pgm))
   	{
 		fprintf(stderr,"File %s not found\n",pgm);
 	   	exit(1);
@@ -98,6 +139,11 @@ int main( int argc, char * argv[] )
 		
 		typeCheck(syntaxTree);
 
+		if (TraceAnalyze)
+			fprintf(listing,"\nFinding Pure Functions...\n");
+
+		findPureFunctions(syntaxTree);
+
 		if (TraceAnalyze)
 			fprintf(listing,"\nType Checking Finished\n");
   	}
@@ -110,7 +156,7 @@ int main( int argc, char * argv[] )
 
 		codefile = (char *) calloc(fnlen+4, sizeof(char));
 		strncpy(codefile,pgm,fnlen);
-		strcat(codefile,".tm");
+		strcat(codefile,x86 ? ".s" : ".tm");
 
 		code = fopen(codefile,"w");
 
@@ -120,7 +166,27 @@ int main( int argc, char * argv[] )
 	  		exit(1);
 		}
 
-		codeGen(syntaxTree,codefile);
+		if (x86)
+			x86Gen(syntaxTree,codefile);
+		else
+		{
+			FILE * lines;
+			char * linefile = (char *) calloc(fnlen+7, sizeof(char));
+
+			codeGen(syntaxTree,codefile);
+
+			/* line table of the code, for tm */
+			strncpy(linefile,pgm,fnlen);
+			strcat(linefile,".lines");
+			lines = fopen(linefile,"w");
+			if (lines == NULL)
+				printf("Unable to open %s\n",linefile);
+			else
+			{
+				emitLineTable(lines);
+				fclose(lines);
+			}
+		}
 
 		fclose(code);
   	}
@@ -128,7 +194,10 @@ int main( int argc, char * argv[] )
 #endif
 #endif
 
-  	fclose(source);
+  	unmapSource();
+
+	/* release the syntax tree and identifiers. */
+	freeArena();
 
   	return 0;
 }
@@ -101,7 +101,7 @@ TreeNode * repeat_stmt(void)
 TreeNode * assign_stmt(void)
 { TreeNode * t = newStmtNode(AssignK);
   if ((t!=NULL) && (token==ID))
-    t->attr.name = copyString(tokenString);
+    t->attr.name = internString(tokenString);
   match(ID);
   match(ASSIGN);
   if (t!=NULL) t->child[0] = exp();
@@ -112,7 +112,7 @@ TreeNode * read_stmt(void)
 { TreeNode * t = newStmtNode(ReadK);
   match(READ);
   if ((t!=NULL) && (token==ID))
-    t->attr.name = copyString(tokenString);
+    t->attr.name = internString(tokenString);
   match(ID);
   return t;
 }
@@ -182,7 +182,7 @@ TreeNode * factor(void)
     case ID :
       t = newExpNode(IdK);
       if ((t!=NULL) && (token==ID))
-        t->attr.name = copyString(tokenString);
+        t->attr.name = internString(tokenString);
       match(ID);
       break;
     case LPAREN :
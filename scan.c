@@ -10,6 +10,12 @@
 #include "scan.h"
 #include "parse.h"
 #include <string.h>
+#include <pthread.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /* states in scanner DFA */
 typedef enum
@@ -21,45 +27,239 @@ typedef enum
 	COMMENTED
 } StateType;
 
-/* lexeme of identifier or reserved word */
-char tokenString[MAXTOKENLEN+1];
-char latestTokenString[MAXTOKENLEN+1];
-
-/* BUFLEN = length of the input buffer for
-   source code lines */
-#define BUFLEN 256
-
-static char lineBuf[BUFLEN]; /* holds the current line */
-static int linepos = 0; /* current position in LineBuf */
-static int bufsize = 0; /* current size of buffer string */
-static int EOF_flag = FALSE; /* corrects ungetNextChar behavior on EOF */
-
-/* getNextChar fetches the next non-blank character
-   from lineBuf, reading in a new line if lineBuf is
-   exhausted */
-static int getNextChar(void)
-{ if (!(linepos < bufsize))
-  { lineno++;
-    if (fgets(lineBuf,BUFLEN-1,source))
-    { if (EchoSource) fprintf(listing,"%4d: %s",lineno,lineBuf);
-      bufsize = strlen(lineBuf);
-      linepos = 0;
-      return lineBuf[linepos++];
+/* classes of characters for the scanner DFA */
+#define CC_OTHER 0
+#define CC_DIGIT 1
+#define CC_LETTER 2
+#define CC_SPACE 3 /* blank, tab, newline */
+
+#define O CC_OTHER
+#define D CC_DIGIT
+#define L CC_LETTER
+#define S CC_SPACE
+
+static const unsigned char charClass[256] =
+{
+	O, O, O, O, O, O, O, O, O, S, S, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	S, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	D, D, D, D, D, D, D, D, D, D, O, O, O, O, O, O,
+	O, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+	L, L, L, L, L, L, L, L, L, L, L, O, O, O, O, O,
+	O, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+	L, L, L, L, L, L, L, L, L, L, L, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+};
+
+#undef O
+#undef D
+#undef L
+#undef S
+
+/* class of character c of getNextChar, EOF included */
+#define classOf(c) ((c) == EOF ? CC_OTHER : charClass[(c)])
+
+/* lexeme of the last token, in the source text */
+const char * tokenString = "";
+int tokenLength = 0;
+
+/* state of a scan of the source text, or of a part of
+   it, in place a line at a time : lineno counts the
+   lines entered */
+typedef struct
+{
+	const char * pos; /* next character */
+	const char * lineEnd; /* end of the current line */
+	const char * end; /* end of the text scanned */
+	int lineno;
+	int EOF_flag; /* corrects ungetNextChar behavior on EOF */
+	const char * tokenStart; /* lexeme of the last token */
+	int tokenLength;
+} ScanState;
+
+/* scan of the whole source text, token by token */
+static ScanState source;
+
+/* getNextChar fetches the next character of the
+   text, entering the next line at the end
+   of the current one */
+static int getNextChar(ScanState * s)
+{ if (s->pos == s->lineEnd)
+  { s->lineno++;
+    if (s->pos < s->end)
+    { s->lineEnd = memchr(s->pos,'\n',s->end - s->pos);
+      s->lineEnd = (s->lineEnd == NULL) ? s->end : s->lineEnd + 1;
+      if (EchoSource)
+        fprintf(listing,"%4d: %.*s",s->lineno,(int) (s->lineEnd - s->pos),s->pos);
     }
     else
-    { EOF_flag = TRUE;
+    { s->EOF_flag = TRUE;
       return EOF;
     }
   }
-  else return lineBuf[linepos++];
+  return (unsigned char) *s->pos++;
 }
 
 /* ungetNextChar backtracks one character
-   in lineBuf */
-static void ungetNextChar(void)
+   in the current line */
+static void ungetNextChar(ScanState * s)
+{
+	if (!s->EOF_flag)
+		s->pos--;
+}
+
+/* Runs of blanks and comments are skipped in bulk,
+   16 or 32 characters at a time with SSE2 or AVX2,
+   or a character at a time otherwise. The vector loops
+   stop short of end, as the mapping may end there. */
+
+/* blankEnd returns the end of the run of blanks
+   (blank, tab, newline) at p, at most end */
+static const char * blankEnd(const char * p, const char * end)
+{
+#if defined(__AVX2__)
+	const __m256i blank = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	while (end - p >= 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *) p);
+		unsigned int m = (unsigned int) _mm256_movemask_epi8(
+				_mm256_or_si256(_mm256_or_si256(
+					_mm256_cmpeq_epi8(v, blank),
+					_mm256_cmpeq_epi8(v, tab)),
+					_mm256_cmpeq_epi8(v, newline)));
+		if (m != 0xFFFFFFFFu)
+			return p + __builtin_ctz(~m);
+		p += 32;
+	}
+#elif defined(__SSE2__)
+	const __m128i blank = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	while (end - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) p);
+		unsigned int m = (unsigned int) _mm_movemask_epi8(
+				_mm_or_si128(_mm_or_si128(
+					_mm_cmpeq_epi8(v, blank),
+					_mm_cmpeq_epi8(v, tab)),
+					_mm_cmpeq_epi8(v, newline)));
+		if (m != 0xFFFFu)
+			return p + __builtin_ctz(~m & 0xFFFFu);
+		p += 16;
+	}
+#endif
+	while (p < end && charClass[(unsigned char) *p] == CC_SPACE)
+		p++;
+	return p;
+}
+
+/* commentEnd returns the end of the first star-slash
+   at or after p, before end, or NULL if there is none */
+static const char * commentEnd(const char * p, const char * end)
 {
-	if (!EOF_flag)
-		linepos--;
+#if defined(__AVX2__)
+	const __m256i star = _mm256_set1_epi8('*');
+	const __m256i slash = _mm256_set1_epi8('/');
+	while (end - p >= 33)
+	{
+		unsigned int m = (unsigned int) _mm256_movemask_epi8(
+				_mm256_and_si256(
+					_mm256_cmpeq_epi8(_mm256_loadu_si256(
+						(const __m256i *) p), star),
+					_mm256_cmpeq_epi8(_mm256_loadu_si256(
+						(const __m256i *) (p + 1)), slash)));
+		if (m != 0)
+			return p + __builtin_ctz(m) + 2;
+		p += 32;
+	}
+#elif defined(__SSE2__)
+	const __m128i star = _mm_set1_epi8('*');
+	const __m128i slash = _mm_set1_epi8('/');
+	while (end - p >= 17)
+	{
+		unsigned int m = (unsigned int) _mm_movemask_epi8(
+				_mm_and_si128(
+					_mm_cmpeq_epi8(_mm_loadu_si128(
+						(const __m128i *) p), star),
+					_mm_cmpeq_epi8(_mm_loadu_si128(
+						(const __m128i *) (p + 1)), slash)));
+		if (m != 0)
+			return p + __builtin_ctz(m) + 2;
+		p += 16;
+	}
+#endif
+	while ((p = memchr(p, '*', end - p)) != NULL && p + 1 < end)
+	{
+		if (p[1] == '/')
+			return p + 2;
+		p++;
+	}
+	return NULL;
+}
+
+/* countNewlines returns the number of newlines
+   from p to end */
+static int countNewlines(const char * p, const char * end)
+{
+	int n = 0;
+#if defined(__AVX2__)
+	const __m256i newline = _mm256_set1_epi8('\n');
+	while (end - p >= 32)
+	{
+		n += __builtin_popcount((unsigned int) _mm256_movemask_epi8(
+				_mm256_cmpeq_epi8(_mm256_loadu_si256(
+					(const __m256i *) p), newline)));
+		p += 32;
+	}
+#elif defined(__SSE2__)
+	const __m128i newline = _mm_set1_epi8('\n');
+	while (end - p >= 16)
+	{
+		n += __builtin_popcount((unsigned int) _mm_movemask_epi8(
+				_mm_cmpeq_epi8(_mm_loadu_si128(
+					(const __m128i *) p), newline)));
+		p += 16;
+	}
+#endif
+	while ((p = memchr(p, '\n', end - p)) != NULL)
+	{
+		n++;
+		p++;
+	}
+	return n;
+}
+
+/* advanceTo moves pos forward to q, past blanks or
+   a comment, entering the lines up to q as getNextChar
+   would : q is in the last line entered, or starts
+   the next one */
+static void advanceTo(ScanState * s, const char * q)
+{
+	if (q > s->lineEnd)
+	{
+		int n = countNewlines(s->lineEnd, q);
+		if (q[-1] == '\n')
+		{
+			s->lineno += n;
+			s->lineEnd = q;
+		}
+		else
+		{
+			s->lineno += n + 1;
+			s->lineEnd = memchr(q, '\n', s->end - q);
+			s->lineEnd = (s->lineEnd == NULL) ? s->end : s->lineEnd + 1;
+		}
+	}
+	s->pos = q;
 }
 
 /* lookup table of reserved words */
@@ -76,59 +276,93 @@ static struct
 	   {"read",READ}, {"write",WRITE} */
    };
 
-/* lookup an identifier to see if it is a reserved word */
-/* uses linear search */
-static TokenType reservedLookup (char * s)
+/* reservedHash is a perfect hash of the reserved words :
+   entry (2 * first character + length) & 7 is the index
+   in reservedWords of the only word that can be there,
+   or -1 */
+#define reservedSlot(s,n) ((2 * (unsigned char) (s)[0] + (n)) & 7)
+
+static const signed char reservedHash[8]
+   = { 5, -1, 3, 2, 0, 4, 1, -1 };
+
+/* length of the longest reserved word */
+#define MAXRESERVEDLEN 6
+
+/* lookup an identifier of length n to see if it is a reserved word */
+/* uses the perfect hash, and one comparison */
+static TokenType reservedLookup (const char * s, int n)
 {
 	int i;
 	
-	for (i=0;i<MAXRESERVED;i++)
+	if (n > MAXRESERVEDLEN)
+		return ID;
+
+	i = reservedHash[reservedSlot(s,n)];
+	if (i >= 0 && strncmp(s,reservedWords[i].str,n) == 0
+			&& reservedWords[i].str[n] == '\0')
 	{
-		if (!strcmp(s,reservedWords[i].str))
-		{
-			return reservedWords[i].tok;
-		}
+		return reservedWords[i].tok;
 	}
 	
 	return ID;
 }
 
 /****************************************/
-/* the primary function of the scanner  */
+/* the DFA of the scanner               */
 /****************************************/
-/* function getToken returns the 
- * next token in source file
+/* function scanToken scans the next token
+ * of s, its lexeme and its line; it reads
+ * only the text and the tables, so parts of
+ * the source text can be scanned at once
  */
-TokenType getToken(void)
+static TokenType scanToken(ScanState * s)
 {
-	/* index for storing into tokenString */
-	int tokenStringIndex = 0;
 	/* holds current token to be returned */
 	TokenType currentToken;
 	/* current state - always begins at START */
 	StateType state = START;
-	/* flag to indicate save to tokenString */
-	int save;
-	
+
 	while (state != DONE)
 	{
-		int c = getNextChar();
-		save = TRUE;
+		/* the lexeme starts at the first character
+		   read in the START state */
+		if (state == START)
+			s->tokenStart = s->pos;
+
+		int c = getNextChar(s);
      
 		switch (state)
 		{ 
 			case START:
-				if (isdigit(c))
+				if (classOf(c) == CC_DIGIT)
+				{
 					state = INNUM;
+					/* the rest of the number, in the current line */
+					while (s->pos < s->lineEnd
+							&& charClass[(unsigned char) *s->pos] == CC_DIGIT)
+						s->pos++;
+				}
 
-				else if (isalpha(c))
+				else if (classOf(c) == CC_LETTER)
+				{
 					state = INID;
+					/* the rest of the identifier, in the current line */
+					while (s->pos < s->lineEnd
+							&& charClass[(unsigned char) *s->pos] == CC_LETTER)
+						s->pos++;
+				}
 
 				else if (c == '=')
 					state = INEQ;
 
-				else if ((c == ' ') || (c == '\t') || (c == '\n'))
-					save = FALSE;
+				else if (classOf(c) == CC_SPACE)
+				{
+					/* skip the rest of the white space, in the
+					   current line only when it is echoed */
+					const char * end = EchoSource ? s->lineEnd : s->end;
+					if (s->pos < end && charClass[(unsigned char) *s->pos] == CC_SPACE)
+						advanceTo(s, blankEnd(s->pos, end));
+				}
 
 				else if (c == '<')
 					state = INLT;
@@ -140,17 +374,14 @@ TokenType getToken(void)
 					state = INNE;
 				
 				else if (c == '/')
-				{
-					save = FALSE;
 					state = INOVER;
-				}
+
 				else
 				{
 					state = DONE;
 					switch (c)
 					{
 						case EOF:
-							save = FALSE;
 							currentToken = ENDFILE;
 							break;
 						case '+':
@@ -196,21 +427,29 @@ TokenType getToken(void)
 	   
 			case INOVER: /* comment mark or 'divide' operation */
 	   			if (c == '*')
-	   			{
-					save = FALSE;
+				{
 	   				state = COMMENTED;
-	   			}
+					/* skip to the end of the comment, unless
+					   its lines are echoed */
+					if (!EchoSource)
+					{
+						const char * end = commentEnd(s->pos, s->end);
+						advanceTo(s, end != NULL ? end : s->end);
+						if (end != NULL)
+							state = START;
+					}
+				}
+
 				else
 				{
 					/* consider c as 'divide' operator. */
 					state = DONE;
 			 		currentToken = OVER;
-					ungetNextChar();
+					ungetNextChar(s);
 				}
 	   			break;
 
 	   		case COMMENTED: /* inside comment mark */
-		  		save = FALSE;
 	   			if (c == EOF)
 		   		{
 					state = DONE;
@@ -218,13 +457,13 @@ TokenType getToken(void)
 		  		}
 				else if (c == '*')
 				{
-					if (getNextChar() == '/')
+					if (getNextChar(s) == '/')
 					{
 						state = START;
 					}
 					else
 					{
-						ungetNextChar();
+						ungetNextChar(s);
 					}
 				}
 	   			break;
@@ -235,7 +474,7 @@ TokenType getToken(void)
 		 			currentToken = EQ;
 	   			else
 	   			{
-		 			ungetNextChar();
+		 			ungetNextChar(s);
 		 			currentToken = ASSIGN;
 	   			}
 	   			break;
@@ -246,7 +485,7 @@ TokenType getToken(void)
 		 			currentToken = GE;
 	   			else
 	   			{
-		 			ungetNextChar();
+		 			ungetNextChar(s);
 		 			currentToken = GT;
 	   			}
 	   			break;
@@ -257,7 +496,7 @@ TokenType getToken(void)
 		 			currentToken = LE;
 	   			else
 	   			{
-		 			ungetNextChar();
+		 			ungetNextChar(s);
 		 			currentToken = LT;
 	   			}
 	   			break;
@@ -268,28 +507,26 @@ TokenType getToken(void)
 		 			currentToken = NE;
 	   			else
 	   			{
-		 			ungetNextChar();
+		 			ungetNextChar(s);
 		 			currentToken = ERROR;
 	   			}
 	   			break;
 
 	 		case INNUM:
-	   			if (!isdigit(c))
+	   			if (classOf(c) != CC_DIGIT)
 	   			{
 					/* backup in the input */
-		 			ungetNextChar();
-		 			save = FALSE;
+		 			ungetNextChar(s);
 		 			state = DONE;
 		 			currentToken = NUM;
 	   			}
 	   			break;
 
 	 		case INID:
-	   			if (!isalpha(c))
+	   			if (classOf(c) != CC_LETTER)
 	   			{
 					/* backup in the input */
-		 			ungetNextChar();
-		 			save = FALSE;
+		 			ungetNextChar(s);
 		 			state = DONE;
 		 			currentToken = ID;
 				}
@@ -303,30 +540,326 @@ TokenType getToken(void)
 	   			break;
    		}
 
-   		if ((save) && (tokenStringIndex <= MAXTOKENLEN))
-	 		tokenString[tokenStringIndex++] = (char) c;
-
    		if (state == DONE)
    		{
-			tokenString[tokenStringIndex] = '\0';
+			s->tokenLength = s->pos - s->tokenStart;
 	 		if (currentToken == ID)
 			{
-	   			currentToken = reservedLookup(tokenString);
+	   			currentToken = reservedLookup(s->tokenStart,s->tokenLength);
 			}
    		}
  	}
 
+ 	return currentToken;
+} /* end scanToken */
+
+/****************************************/
+/* the pre-tokenised source text        */
+/****************************************/
+
+/* a token of the source text */
+typedef struct
+{
+	TokenType kind;
+	int lineno;
+	int start; /* offset of the lexeme in the source text */
+	int length;
+} TokenRec;
+
+/* the tokens of the source text, when it is lexed
+   ahead of the parser : the last one is ENDFILE */
+static TokenRec * tokens = NULL;
+static int tokenCount = 0;
+static int nextToken = 0;
+
+/* parts of the source text shorter than this are
+   not worth a thread of their own */
+#define MIN_PART_LENGTH 65536
+
+/* a part of the source text, from a line start
+   outside comments to the next one, and its tokens */
+typedef struct
+{
+	const char * start;
+	const char * end;
+	TokenRec * tokens;
+	int count;
+	int capacity;
+	int failed; /* out of memory */
+	int lines; /* newlines in the part */
+	int first; /* index of its first token in tokens */
+	int lineno; /* lines before the part */
+} LexPart;
+
+/* commentStart returns the first slash-star at or
+   after p, before end, or NULL if there is none */
+static const char * commentStart(const char * p, const char * end)
+{
+	while ((p = memchr(p, '/', end - p)) != NULL && p + 1 < end)
+	{
+		if (p[1] == '*')
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+/* lineStart returns the start of the first line
+   at or after p, or end */
+static const char * lineStart(const char * p, const char * end)
+{
+	if (p == sourceText || p[-1] == '\n')
+		return p;
+	p = memchr(p, '\n', end - p);
+	return (p == NULL) ? end : p + 1;
+}
+
+/* partBoundary returns the first line start at or
+   after b that is outside comments, or end; *p is
+   outside comments before b, and is moved to the
+   boundary past the comments found */
+static const char * partBoundary(const char ** p, const char * b,
+		const char * end)
+{
+	const char * c;
+	const char * e;
+
+	b = lineStart(b, end);
+	while ((c = commentStart(*p, b)) != NULL)
+	{
+		e = commentEnd(c + 2, end);
+		if (e == NULL)
+			return end;
+		*p = e;
+		if (e > b)
+			b = lineStart(e, end);
+	}
+	*p = b;
+	return b;
+}
+
+/* lexPart scans a part of the source text into
+   its tokens, with lines counted from the part
+   start */
+static void * lexPart(void * arg)
+{
+	LexPart * part = arg;
+	ScanState s;
+	TokenType t;
+
+	memset(&s, 0, sizeof(s));
+	s.pos = s.lineEnd = part->start;
+	s.end = part->end;
+	part->lines = countNewlines(part->start, part->end);
+	part->capacity = (int) ((part->end - part->start) / 4) + 16;
+	part->tokens = malloc(part->capacity * sizeof(TokenRec));
+	do
+	{
+		if (part->tokens != NULL && part->count == part->capacity)
+		{
+			TokenRec * grown = realloc(part->tokens,
+					2 * part->capacity * sizeof(TokenRec));
+			if (grown == NULL)
+				free(part->tokens);
+			part->tokens = grown;
+			part->capacity *= 2;
+		}
+		if (part->tokens == NULL)
+		{
+			part->failed = TRUE;
+			return NULL;
+		}
+		t = scanToken(&s);
+		part->tokens[part->count].kind = t;
+		part->tokens[part->count].lineno = s.lineno;
+		part->tokens[part->count].start = (int) (s.tokenStart - sourceText);
+		part->tokens[part->count].length = s.tokenLength;
+		part->count++;
+	} while (t != ENDFILE);
+	return NULL;
+}
+
+/* joinPart copies the tokens of a part into tokens,
+   but the ENDFILE ending each part but the last,
+   with lines counted from the start of the text */
+static void * joinPart(void * arg)
+{
+	LexPart * part = arg;
+	int count = part->count;
+	int i;
+
+	if (part->end < sourceText + sourceLength)
+		count--;
+	for (i = 0; i < count; i++)
+	{
+		tokens[part->first + i] = part->tokens[i];
+		tokens[part->first + i].lineno += part->lineno;
+	}
+	return NULL;
+}
+
+/* runParts applies f to the m parts in parallel : the
+   first part on this thread, and a part whose thread
+   cannot be started after the others */
+static void runParts(void * (* f)(void *), LexPart * parts, int m,
+		pthread_t * threads, int * started)
+{
+	int k;
+
+	for (k = 1; k < m; k++)
+		started[k] = pthread_create(&threads[k], NULL, f, &parts[k]) == 0;
+	f(&parts[0]);
+	for (k = 1; k < m; k++)
+	{
+		if (started[k])
+			pthread_join(threads[k], NULL);
+		else
+			f(&parts[k]);
+	}
+}
+
+/* lexSource scans the whole source text into tokens :
+ * the text is split at line starts outside comments
+ * into at most LexThreads parts, scanned in parallel,
+ * whose tokens are then joined. It returns FALSE if
+ * memory runs out, leaving the text to be scanned
+ * token by token.
+ */
+static int lexSource(void)
+{
+	const char * end = sourceText + sourceLength;
+	const char * p = sourceText;
+	LexPart * parts;
+	pthread_t * threads;
+	int * started;
+	int n, m, k, failed = FALSE;
+
+	n = (int) (sourceLength / MIN_PART_LENGTH) + 1;
+	if (n > LexThreads)
+		n = LexThreads;
+	parts = calloc(n, sizeof(LexPart));
+	threads = calloc(n, sizeof(pthread_t));
+	started = calloc(n, sizeof(int));
+	if (parts == NULL || threads == NULL || started == NULL)
+	{
+		free(parts);
+		free(threads);
+		free(started);
+		return FALSE;
+	}
+
+	/* parts of about the same length */
+	parts[0].start = sourceText;
+	m = 1;
+	for (k = 1; k < n; k++)
+	{
+		const char * b = sourceText + sourceLength * k / n;
+		if (b <= parts[m - 1].start)
+			continue;
+		b = partBoundary(&p, b, end);
+		if (b >= end)
+			break;
+		parts[m - 1].end = b;
+		parts[m++].start = b;
+	}
+	parts[m - 1].end = end;
+
+	runParts(lexPart, parts, m, threads, started);
+	for (k = 0; k < m; k++)
+		failed = failed || parts[k].failed;
+
+	if (failed)
+		tokens = NULL;
+	else if (m == 1)
+	{
+		/* a single part is already in place */
+		tokens = parts[0].tokens;
+		tokenCount = parts[0].count;
+		parts[0].tokens = NULL;
+	}
+	else
+	{
+		tokenCount = 0;
+		for (k = 0; k < m; k++)
+		{
+			parts[k].first = tokenCount;
+			parts[k].lineno = (k == 0) ? 0
+					: parts[k - 1].lineno + parts[k - 1].lines;
+			tokenCount += (k < m - 1) ? parts[k].count - 1 : parts[k].count;
+		}
+		tokens = malloc(tokenCount * sizeof(TokenRec));
+		if (tokens != NULL)
+			runParts(joinPart, parts, m, threads, started);
+	}
+
+	for (k = 0; k < m; k++)
+		free(parts[k].tokens);
+	free(parts);
+	free(threads);
+	free(started);
+	return tokens != NULL;
+}
+
+/****************************************/
+/* the primary function of the scanner  */
+/****************************************/
+/* function getToken returns the 
+ * next token in source file
+ */
+TokenType getToken(void)
+{
+	/* holds current token to be returned */
+	TokenType currentToken;
+	/* value of NUM */
+	unsigned int value = 0;
+	int i;
+
+	if (source.pos == NULL)
+	{
+		source.pos = source.lineEnd = sourceText;
+		source.end = sourceText + sourceLength;
+		/* lex the whole text first, unless its
+		   lines are echoed as they are scanned */
+		if (LexThreads > 0 && !EchoSource)
+			lexSource();
+	}
+
+	if (tokens != NULL)
+	{
+		TokenRec * t = &tokens[nextToken];
+		/* ENDFILE is returned again at the end */
+		if (nextToken < tokenCount - 1)
+			nextToken++;
+		currentToken = t->kind;
+		lineno = t->lineno;
+		tokenString = sourceText + t->start;
+		tokenLength = t->length;
+	}
+	else
+	{
+		currentToken = scanToken(&source);
+		lineno = source.lineno;
+		tokenString = source.tokenStart;
+		tokenLength = source.tokenLength;
+	}
+
  	if (TraceScan)
 	{
    		fprintf(listing,"\t%d: ",lineno);
-   		printToken(currentToken,tokenString);
+   		printToken(currentToken,tokenString,tokenLength);
  	}
 
-	if (currentToken == ID || currentToken == NUM)
+	/* semantic value for the parser */
+	if (currentToken == ID)
 	{
-		strncpy(latestTokenString, tokenString, MAXTOKENLEN + 1);
+		yylval.name = internName(tokenString,tokenLength);
+	}
+	else if (currentToken == NUM)
+	{
+		for (i = 0; i < tokenLength; i++)
+			value = value * 10 + (tokenString[i] - '0');
+		yylval.val = (int) value;
 	}
 
  	return currentToken;
 } /* end getToken */
-
@@ -12,25 +12,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include "symtab.h"
+#include "util.h"
 
-/* SHIFT is the power of two used as multiplier
-   in hash function  */
-#define SHIFT 4
+/* the hash function : names are interned,
+   with their hash computed once */
+#define hash(name) (nameHash(name) % SIZE)
 
-/* the hash function */
-static int hash ( char * key )
-{
-    int ret = 0;
-    int i = 0;
-    
-    while (key[i] != '\0')
-    {
-        ret = ((ret << SHIFT) + key[i]) % SIZE;
-        ++i;
-    }
-    
-    return ret;
-}
+/* represents global scope. */
+struct SymbolTable *globalTable;
 
 /* Procedure st_insert inserts line numbers and
  * memory locations into the symbol table
@@ -38,10 +27,10 @@ static int hash ( char * key )
 int st_insert( BucketList *hashTable, TreeNode *t, int is_function,
        int location, int is_global, int is_param )
 {
-    int h = hash(t->attr.name);
+    int h = hash(NAME(t));
     BucketList l =  hashTable[h];
     
-    while ( (l != NULL) && (strcmp(t->attr.name,l->name) != 0) )
+    while ( (l != NULL) && (NAME(t) != l->name) )
     {
         l = l->next;
     }
@@ -49,7 +38,7 @@ int st_insert( BucketList *hashTable, TreeNode *t, int is_function,
     if (l == NULL) /* variable not yet in table */
     {
         l = (BucketList) malloc(sizeof(struct BucketListRec));
-        l->name = t->attr.name;
+        l->name = NAME(t);
         l->lineno = t->lineno;
         l->is_function = is_function;
         l->type = t->type;
@@ -58,6 +47,8 @@ int st_insert( BucketList *hashTable, TreeNode *t, int is_function,
         l->is_param = is_param;
         l->is_global = is_global;
         l->location = location;
+        l->is_pure = 0;
+        l->is_recursive = 0;
 
         l->next = hashTable[h];
         hashTable[h] = l;
@@ -71,28 +62,26 @@ int st_insert( BucketList *hashTable, TreeNode *t, int is_function,
 } /* st_insert */
 
 /**
- * st_lookup calls table_lookup recursively finds the variable from bottom to up.
+ * st_lookup calls table_lookup for each scope, finds the variable from bottom to up.
  */
 BucketList st_lookup ( struct SymbolTable *table, char * name )
 {
-    BucketList lookup_result = table_lookup( table->hashTable, name );
+    int h = hash(name);
+    BucketList l;
 
-    if (lookup_result != NULL)
-    {
-        return lookup_result;
-    }
-    else
+    for ( ; table != NULL; table = table->parent)
     {
-        if (table->parent == NULL)
+        for (l = table->hashTable[h]; l != NULL; l = l->next)
         {
-            /* reached over global scope : return -1. */
-            return NULL;
-        }
-        else
-        {
-            return st_lookup( table->parent, name );
+            if (l->name == name)
+            {
+                return l;
+            }
         }
     }
+
+    /* reached over global scope. */
+    return NULL;
 }
 
 /* Function table_lookup returns 0 if found, or -1 if not found
@@ -102,7 +91,7 @@ BucketList table_lookup ( BucketList *hashTable, char * name )
     int h = hash(name);
     BucketList l =  hashTable[h];
 
-    while ( (l != NULL) && (strcmp(name,l->name) != 0) )
+    while ( (l != NULL) && (name != l->name) )
     {
         l = l->next;
     }
@@ -138,7 +127,8 @@ struct SymbolTable *findNewTableInOrder(
 {
     struct SymbolTable *childTable, *resultTable;
 
-    if (currentTable != NULL)
+    /* loop through siblings. */
+    while (currentTable != NULL)
     {
         if (currentTable->order == order)
         {
@@ -159,7 +149,7 @@ struct SymbolTable *findNewTableInOrder(
         }
 
         /* search through siblings. */
-        return findNewTableInOrder(currentTable->sibling, order);
+        currentTable = currentTable->sibling;
     }
     
     return NULL;
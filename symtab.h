@@ -12,14 +12,11 @@
 /* SIZE is the size of the hash table */
 #define SIZE 211
 
-/* NAME_LENGTH is the max length of function name. */
-#define NAME_LENGTH 100
-
 #include "globals.h"
 
 
 /* The record in the bucket lists for
- * each variable, including name, 
+ * each variable, including name (interned), 
  * assigned memory location, and
  * the list of line numbers in which
  * it appears in the source code
@@ -36,6 +33,12 @@ typedef struct BucketListRec
     int is_param;
     int is_global;
     int location; /* address that this symbol is stored in */
+
+    /* function reads no global, calls neither input nor output,
+       takes only int parameters and calls only pure functions. */
+    int is_pure;
+    /* function calls itself. */
+    int is_recursive;
 } *BucketList;
 
 /**
@@ -47,8 +50,8 @@ struct SymbolTable
     /* hashTable has the data of whole declarations. */
     BucketList hashTable[SIZE];
 
-    /* functionName has the name of function. global is set to __GLOBAL__. */
-    char functionName[NAME_LENGTH];
+    /* functionName has the interned name of function. global is set to __GLOBAL__. */
+    char *functionName;
 
     /* depth represents nested level. */
     int depth;
@@ -71,7 +74,7 @@ struct SymbolTable
 };
 
 /* represents global scope. */
-struct SymbolTable *globalTable;
+extern struct SymbolTable *globalTable;
 
 /* Procedure st_insert inserts line numbers and
  * memory locations into the symbol table
@@ -80,7 +83,8 @@ int st_insert( BucketList *hashTable, TreeNode *t, int is_function,
         int location, int is_global, int is_param );
 
 /**
- * st_lookup calls table_lookup recursively finds the variable from bottom to up.
+ * st_lookup calls table_lookup for each scope, finds the variable from bottom to up.
+ * names are interned, as all names of the syntax tree.
  */
 BucketList st_lookup ( struct SymbolTable *table, char * name );
 
@@ -9,99 +9,76 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
 
-#ifndef TRUE
-#define TRUE 1
-#endif
-#ifndef FALSE
-#define FALSE 0
-#endif
+#include "libtm.h"
+#include "tmtrace.h"
 
 /******* const *******/
-#define   IADDR_SIZE  1024 /* increase for large programs */
-#define   DADDR_SIZE  1024 /* increase for large programs */
-#define   NO_REGS 8
-#define   PC_REG  7
+#define   MP_REG  6  /* stack pointer of cgen */
+#define   FP_REG  4  /* frame pointer of cgen */
+#define   GP_REG  5  /* global pointer of cgen */
 
 #define   LINESIZE  121
 #define   WORDSIZE  20
 
 /******* type  *******/
 
-typedef enum {
-   opclRR,     /* reg operands r,s,t */
-   opclRM,     /* reg r, mem d+s */
-   opclRA      /* reg r, int d+s */
-   } OPCLASS;
-
-typedef enum {
-   /* RR instructions */
-   opHALT,    /* RR     halt, operands are ignored */
-   opIN,      /* RR     read into reg(r); s and t are ignored */
-   opOUT,     /* RR     write from reg(r), s and t are ignored */
-   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
-   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
-   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
-   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
-   opRRLim,   /* limit of RR opcodes */
-
-   /* RM instructions */
-   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
-   opST,      /* RM     mem(d+reg(s)) = reg(r) */
-   opRMLim,   /* Limit of RM opcodes */
-
-   /* RA instructions */
-   opLDA,     /* RA     reg(r) = d+reg(s) */
-   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
-   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
-   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
-   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
-   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
-   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
-   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
-   opRALim    /* Limit of RA opcodes */
-   } OPCODE;
-
-typedef enum {
-   srOKAY,
-   srHALT,
-   srIMEM_ERR,
-   srDMEM_ERR,
-   srZERODIVIDE
-   } STEPRESULT;
-
+/* streams of the IN and OUT hooks */
 typedef struct {
-      int iop  ;
-      int iarg1  ;
-      int iarg2  ;
-      int iarg3  ;
-   } INSTRUCTION;
+      FILE * in ;   /* IN reads from in, or from the terminal if NULL */
+      FILE * out ;  /* OUT writes to out */
+   } STREAMS;
 
 /******** vars ********/
 int iloc = 0 ;
 int dloc = 0 ;
 int traceflag = FALSE;
 int icountflag = FALSE;
+int profileflag = FALSE;
+int memflag = FALSE;
+long fuelLimit = 0 ;      /* instructions per run, 0 if unlimited */
+double timeLimit = 0 ;    /* seconds per run, 0 if unlimited */
+char * traceName = NULL ; /* binary trace of 'go' runs, or NULL */
+
+TM_VM machine ;     /* machine of the read-eval-print loop */
+STREAMS terminal ;  /* its streams */
 
-INSTRUCTION iMem [IADDR_SIZE];
-int dMem [DADDR_SIZE];
-int reg [NO_REGS];
+/* function entered at each location : from "* Function: name"
+   comments of the code file, or from a symbol map */
+char * funcName [IADDR_SIZE];
+/* source line of each location, from the line table
+   <program>.lines written by the compiler (0 if unknown) */
+int srcLine [IADDR_SIZE];
+int maxSrcLine = 0 ;
+int srcFunc [IADDR_SIZE];   /* index of the function in funcTab, or -1 */
+char * funcTab [IADDR_SIZE];
+int nFuncs = 0 ;
 
-char * opCodeTab[]
-        = {"HALT","IN","OUT","ADD","SUB","MUL","DIV","????",
-            /* RR opcodes */
-           "LD","ST","????", /* RM opcodes */
-           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
-           /* RA opcodes */
-          };
+/* variables of the line table : memory regions of the
+   memory profile, with gp or the fp of a frame of their
+   function as base */
+typedef struct {
+      int func ;     /* index in funcTab, or -1 if global */
+      char * name ;
+      int loc ;      /* words at base-loc-size+1 .. base-loc */
+      int size ;
+      long loads ;
+      long stores ;
+   } REGION;
 
-char * stepResultTab[]
-        = {"OK","Halted","Instruction Memory Fault",
-           "Data Memory Fault","Division by 0"
-          };
+#define   MAX_REGIONS  256
+REGION regions [MAX_REGIONS];
+int nRegions = 0 ;
 
-char pgmName[20];
-FILE *pgm  ;
+char * pgmName ;    /* the code file */
 
 char in_Line[LINESIZE] ;
 int lineLen ;
@@ -111,25 +88,24 @@ char word[WORDSIZE] ;
 char ch  ;
 int done  ;
 
-/********************************************/
-int opClass( int c )
-{ if      ( c <= opRRLim) return ( opclRR );
-  else if ( c <= opRMLim) return ( opclRM );
-  else                    return ( opclRA );
-} /* opClass */
-
 /********************************************/
 void writeInstruction ( int loc )
 { printf( "%5d: ", loc) ;
   if ( (loc >= 0) && (loc < IADDR_SIZE) )
-  { printf("%6s%3d,", opCodeTab[iMem[loc].iop], iMem[loc].iarg1);
-    switch ( opClass(iMem[loc].iop) )
-    { case opclRR: printf("%1d,%1d", iMem[loc].iarg2, iMem[loc].iarg3);
+  { printf("%6s%3d,", opCodeTab[machine.iMem[loc].iop], machine.iMem[loc].iarg1);
+    switch ( opClass(machine.iMem[loc].iop) )
+    { case opclRR: printf("%1d,%1d", machine.iMem[loc].iarg2, machine.iMem[loc].iarg3);
                    break;
       case opclRM:
-      case opclRA: printf("%3d(%1d)", iMem[loc].iarg2, iMem[loc].iarg3);
+      case opclRA: printf("%3d(%1d)", machine.iMem[loc].iarg2, machine.iMem[loc].iarg3);
+                   break;
+      case opclRB: printf("%1d,%3d", machine.iMem[loc].iarg2, machine.iMem[loc].iarg3);
+                   break;
+      case opclRX: printf("%3d(%1d,%1d)", machine.iMem[loc].iarg2, machine.iMem[loc].iarg3,
+                          machine.iMem[loc].iarg4);
                    break;
     }
+    if (srcLine[loc] > 0) printf ("\tline %d", srcLine[loc]) ;
     printf ("\n") ;
   }
 } /* writeInstruction */
@@ -210,199 +186,1422 @@ int atEOL(void)
 } /* atEOL */
 
 /********************************************/
-int error( char * msg, int lineNo, int instNo)
-{ printf("Line %d",lineNo);
-  if (instNo >= 0) printf(" (Instruction %d)",instNo);
-  printf("   %s\n",msg);
-  return FALSE;
-} /* error */
+/* IN and OUT hooks of the machines, on the */
+/* STREAMS of vm->user                      */
+int streamIn ( TM_VM * vm, int * value )
+{ STREAMS * st = (STREAMS *) vm->user ;
+  int ok ;
+  if ( st->in != NULL )
+    return fscanf(st->in, "%d", value) == 1 ;
+  do
+  { printf("Enter value for IN instruction: ") ;
+    fflush (stdin);
+    fflush (stdout);
+    gets(in_Line);
+    lineLen = strlen(in_Line) ;
+    inCol = 0;
+    ok = getNum();
+    if ( ! ok ) printf ("Illegal value\n");
+    else *value = num;
+  }
+  while (! ok);
+  return TRUE ;
+} /* streamIn */
+
+/********************************************/
+void streamOut ( TM_VM * vm, int value )
+{ fprintf(((STREAMS *) vm->user)->out,
+          "OUT instruction prints: %d\n", value) ;
+} /* streamOut */
+
+/********************************************/
+/* message of the HALT just executed        */
+void writeHalt ( FILE * f, TM_VM * vm )
+{ INSTRUCTION * halt = &vm->iMem[vm->reg[PC_REG] - 1] ;
+  fprintf(f, "HALT: %1d,%1d,%1d\n", halt->iarg1, halt->iarg2, halt->iarg3) ;
+} /* writeHalt */
+
+/********************************************/
+/* "* Function: name" comments name the     */
+/* function entries                         */
+void labelFunction ( TM_VM * vm, int loc, char * name )
+{ free(funcName[loc]) ;
+  funcName[loc] = strdup(name) ;
+} /* labelFunction */
 
 /********************************************/
 int readInstructions (void)
-{ OPCODE op;
-  int arg1, arg2, arg3;
-  int loc, regNo, lineNo;
-  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
-      reg[regNo] = 0 ;
-  dMem[0] = DADDR_SIZE - 1 ;
-  for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-      dMem[loc] = 0 ;
+{ int ok = tm_load_file(&machine, pgmName) ;
+  if ( ! ok ) printf("%s\n", machine.error) ;
+  return ok ;
+} /* readInstructions */
+
+/********************************************/
+/* read the line table of the compiler, if  */
+/* there is one : lines of                  */
+/* "first last lineno function" and of      */
+/* "var function name loc size"             */
+int funcIndex ( char * name )
+{ int i ;
+  if (strcmp(name, "-") == 0) return -1 ;
+  for (i = 0 ; i < nFuncs ; i++)
+    if (strcmp(funcTab[i], name) == 0) return i ;
+  funcTab[nFuncs] = strdup(name) ;
+  return nFuncs++ ;
+} /* funcIndex */
+
+/********************************************/
+/* name of the file next to the code file,  */
+/* with extension ext in place of its own : */
+/* the caller frees it                      */
+char * sideName ( char * ext )
+{ char * dot = strrchr(pgmName, '.') ;
+  char * slash = strrchr(pgmName, '/') ;
+  int base = strlen(pgmName) ;
+  int size ;
+  char * name ;
+
+  if ((dot != NULL) && ((slash == NULL) || (dot > slash)))
+    base = dot - pgmName ;
+  size = base + strlen(ext) + 1 ;
+  name = (char *) malloc(size) ;
+  snprintf(name, size, "%.*s%s", base, pgmName, ext) ;
+  return name ;
+} /* sideName */
+
+void readLineTable (void)
+{ char * lineName ;
+  char name[LINESIZE] ;
+  char var[LINESIZE] ;
+  int first, last, line, loc, size ;
+  int func, prevFunc = -1 ;
+  FILE * f ;
+
   for (loc = 0 ; loc < IADDR_SIZE ; loc++)
-  { iMem[loc].iop = opHALT ;
-    iMem[loc].iarg1 = 0 ;
-    iMem[loc].iarg2 = 0 ;
-    iMem[loc].iarg3 = 0 ;
-  }
-  lineNo = 0 ;
-  while (! feof(pgm))
-  { fgets( in_Line, LINESIZE-2, pgm  ) ;
-    inCol = 0 ; 
-    lineNo++;
-    lineLen = strlen(in_Line)-1 ;
-    if (in_Line[lineLen]=='\n') in_Line[lineLen] = '\0' ;
-    else in_Line[++lineLen] = '\0';
-    if ( (nonBlank()) && (in_Line[inCol] != '*') )
-    { if (! getNum())
-        return error("Bad location", lineNo,-1);
-      loc = num;
-      if (loc > IADDR_SIZE)
-        return error("Location too large",lineNo,loc);
-      if (! skipCh(':'))
-        return error("Missing colon", lineNo,loc);
-      if (! getWord ())
-        return error("Missing opcode", lineNo,loc);
-      op = opHALT ;
-      while ((op < opRALim)
-             && (strncmp(opCodeTab[op], word, 4) != 0) )
-          op++ ;
-      if (strncmp(opCodeTab[op], word, 4) != 0)
-          return error("Illegal opcode", lineNo,loc);
-      switch ( opClass(op) )
-      { case opclRR :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo, loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad second register", lineNo, loc);
-        arg2 = num;
-        if ( ! skipCh(',')) 
-            return error("Missing comma", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad third register", lineNo,loc);
-        arg3 = num;
-        break;
-
-        case opclRM :
-        case opclRA :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo,loc);
-        if (! getNum ())
-            return error("Bad displacement", lineNo,loc);
-        arg2 = num;
-        if ( ! skipCh('(') && ! skipCh(',') )
-            return error("Missing LParen", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS))
-            return error("Bad second register", lineNo,loc);
-        arg3 = num;
-        break;
-        }
-      iMem[loc].iop = op;
-      iMem[loc].iarg1 = arg1;
-      iMem[loc].iarg2 = arg2;
-      iMem[loc].iarg3 = arg3;
+    srcFunc[loc] = -1 ;
+  lineName = sideName(".lines") ;
+  f = fopen(lineName, "r") ;
+  free(lineName) ;
+  if (f == NULL)
+    return ;
+  while (fgets(in_Line, LINESIZE, f) != NULL)
+  { if (sscanf(in_Line, "var %120s %120s %d %d", name, var, &loc, &size) == 4)
+    { if (nRegions < MAX_REGIONS)
+      { regions[nRegions].func = funcIndex(name) ;
+        regions[nRegions].name = strdup(var) ;
+        regions[nRegions].loc = loc ;
+        regions[nRegions].size = size ;
+        nRegions++ ;
+      }
+      continue ;
+    }
+    if ((sscanf(in_Line, "%d %d %d %120s", &first, &last, &line, name) != 4)
+        || (first < 0) || (last >= IADDR_SIZE) || (first > last))
+      continue ;
+    func = funcIndex(name) ;
+    for (loc = first ; loc <= last ; loc++)
+    { srcLine[loc] = line ;
+      srcFunc[loc] = func ;
     }
+    if (line > maxSrcLine) maxSrcLine = line ;
+    /* the first range of a function is its entry */
+    if ((func >= 0) && (func != prevFunc) && (funcName[first] == NULL))
+      funcName[first] = strdup(name) ;
+    prevFunc = func ;
   }
-  return TRUE;
-} /* readInstructions */
+  fclose(f) ;
+} /* readLineTable */
 
 
 /********************************************/
-STEPRESULT stepTM (void)
-{ INSTRUCTION currentinstruction  ;
-  int pc  ;
-  int r,s,t,m  ;
-  int ok ;
+/* memory profile : every LD/ST/LDX/STX is  */
+/* counted by address and by region, and    */
+/* fed into a set-associative cache model   */
+/* with LRU replacement                     */
+/********************************************/
+#define   MAX_WAYS  16
 
-  pc = reg[PC_REG] ;
-  if ( (pc < 0) || (pc > IADDR_SIZE)  )
-      return srIMEM_ERR ;
-  reg[PC_REG] = pc + 1 ;
-  currentinstruction = iMem[ pc ] ;
-  switch (opClass(currentinstruction.iop) )
-  { case opclRR :
-    /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg2 ;
-      t = currentinstruction.iarg3 ;
-      break;
+long memLoads [DADDR_SIZE] ;
+long memStores [DADDR_SIZE] ;
+long globalAccesses, stackAccesses ;
 
-    case opclRM :
-    /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg3 ;
-      m = currentinstruction.iarg2 + reg[s] ;
-      if ( (m < 0) || (m > DADDR_SIZE))
-         return srDMEM_ERR ;
-      break;
+int cacheSets = 64 ;
+int cacheWays = 2 ;
+int cacheLine = 8 ;            /* words */
+int * cacheTag = NULL ;        /* cacheSets * cacheWays, -1 if empty */
+long * cacheUsed = NULL ;      /* time of last use, for LRU */
+long cacheTime, cacheHits, cacheMisses ;
 
-    case opclRA :
-    /***********************************/
-      r = currentinstruction.iarg1 ;
-      s = currentinstruction.iarg3 ;
-      m = currentinstruction.iarg2 + reg[s] ;
-      break;
-  } /* case */
+/********************************************/
+void clearMemProfile (void)
+{ int i ;
+  for (i = 0 ; i < DADDR_SIZE ; i++)
+  { memLoads[i] = 0 ;
+    memStores[i] = 0 ;
+  }
+  for (i = 0 ; i < nRegions ; i++)
+  { regions[i].loads = 0 ;
+    regions[i].stores = 0 ;
+  }
+  globalAccesses = stackAccesses = 0 ;
+  free(cacheTag) ;
+  free(cacheUsed) ;
+  cacheTag = (int *) malloc(cacheSets * cacheWays * sizeof(int)) ;
+  cacheUsed = (long *) calloc(cacheSets * cacheWays, sizeof(long)) ;
+  for (i = 0 ; i < cacheSets * cacheWays ; i++)
+    cacheTag[i] = -1 ;
+  cacheTime = cacheHits = cacheMisses = 0 ;
+} /* clearMemProfile */
 
-  switch ( currentinstruction.iop)
-  { /* RR instructions */
-    case opHALT :
-    /***********************************/
-      printf("HALT: %1d,%1d,%1d\n",r,s,t);
-      return srHALT ;
-      /* break; */
+/********************************************/
+/* region of address m : globals are based  */
+/* on gp, locals on the fp of the frames of */
+/* their function (the return address of a  */
+/* frame is kept at fp+2, the previous fp   */
+/* at fp+1)                                 */
+REGION * findRegion ( TM_VM * mc, int pc, int m )
+{ int f = mc->reg[FP_REG] ;
+  int func = srcFunc[pc] ;
+  int base, i, depth ;
+
+  for (i = 0 ; i < nRegions ; i++)
+    if (regions[i].func < 0)
+    { base = mc->reg[GP_REG] - regions[i].loc ;
+      if ((m <= base) && (m > base - regions[i].size))
+        return &regions[i] ;
+    }
+  for (depth = 0 ; (func >= 0) && (depth < DADDR_SIZE) ; depth++)
+  { for (i = 0 ; i < nRegions ; i++)
+      if (regions[i].func == func)
+      { base = f - regions[i].loc ;
+        if ((m <= base) && (m > base - regions[i].size))
+          return &regions[i] ;
+      }
+    if ((f < 0) || (f + 2 >= DADDR_SIZE))
+      break ;
+    pc = mc->dMem[f + 2] ;
+    if ((pc < 0) || (pc >= IADDR_SIZE))
+      break ;
+    func = srcFunc[pc] ;
+    f = mc->dMem[f + 1] ;
+  }
+  return NULL ;
+} /* findRegion */
+
+/********************************************/
+void memAccess ( TM_VM * mc, int pc, int m, int store )
+{ REGION * region = findRegion(mc, pc, m) ;
+  int set, way, victim ;
+  int tag = m / cacheLine ;
+  int * tags ;
+  long * used ;
+
+  if (store) memStores[m]++ ; else memLoads[m]++ ;
+  if (region == NULL) stackAccesses++ ;
+  else if ((region->size == 1) && (region->func < 0)) globalAccesses++ ;
+  else if (region->size == 1) stackAccesses++ ;
+  else if (store) region->stores++ ;
+  else region->loads++ ;
+
+  set = tag % cacheSets ;
+  tags = cacheTag + set * cacheWays ;
+  used = cacheUsed + set * cacheWays ;
+  cacheTime++ ;
+  victim = 0 ;
+  for (way = 0 ; way < cacheWays ; way++)
+  { if (tags[way] == tag)
+    { cacheHits++ ;
+      used[way] = cacheTime ;
+      return ;
+    }
+    if (used[way] < used[victim]) victim = way ;
+  }
+  cacheMisses++ ;
+  tags[victim] = tag ;
+  used[victim] = cacheTime ;
+} /* memAccess */
+
+/********************************************/
+void writeMemProfile (void)
+{ long loads = 0, stores = 0, count ;
+  int i, a ;
+
+  for (a = 0 ; a < DADDR_SIZE ; a++)
+  { loads += memLoads[a] ;
+    stores += memStores[a] ;
+  }
+  printf("Memory accesses: %ld loads, %ld stores\n", loads, stores) ;
+  printf("%12s  %s\n", "accesses", "region") ;
+  printf("%12ld  (globals)\n", globalAccesses) ;
+  printf("%12ld  (stack)\n", stackAccesses) ;
+  for (i = 0 ; i < nRegions ; i++)
+    if (regions[i].size > 1)
+    { printf("%12ld  %s%s%s[%d] (%ld loads, %ld stores)\n",
+             regions[i].loads + regions[i].stores,
+             (regions[i].func < 0) ? "" : funcTab[regions[i].func],
+             (regions[i].func < 0) ? "" : ".",
+             regions[i].name, regions[i].size,
+             regions[i].loads, regions[i].stores) ;
+    }
+
+  /* heat map : accesses by blocks of cache lines */
+  printf("%12s  %s\n", "accesses", "addresses") ;
+  for (a = 0 ; a < DADDR_SIZE ; a += cacheLine)
+  { count = 0 ;
+    for (i = a ; (i < a + cacheLine) && (i < DADDR_SIZE) ; i++)
+      count += memLoads[i] + memStores[i] ;
+    if (count > 0)
+      printf("%12ld  %d..%d\n", count, a, a + cacheLine - 1) ;
+  }
+
+  printf("Cache: %d sets, %d ways, %d words per line\n",
+         cacheSets, cacheWays, cacheLine) ;
+  if (cacheHits + cacheMisses > 0)
+    printf("   %ld hits, %ld misses, hit rate %.2f%%\n", cacheHits,
+           cacheMisses, 100.0 * cacheHits / (cacheHits + cacheMisses)) ;
+} /* writeMemProfile */
+
+/********************************************/
+/* batched execution of one program over    */
+/* many input streams. lane state is kept   */
+/* in struct-of-arrays layout, the running  */
+/* lanes first : while they are all at the  */
+/* same pc, each instruction is one loop    */
+/* over the lanes, without masks.           */
+/********************************************/
+#define   BATCH_LANES  64
+
+/* an instruction decoded once for the lanes */
+typedef struct {
+      int op ;
+      int r, s, t ;  /* registers, 0 if unused */
+      int d ;        /* displacement or constant, the target of RB */
+      int pcUse ;    /* reads or writes the pc */
+      int setsPc ;   /* writes the pc */
+   } DECODED;
+
+DECODED bCode [IADDR_SIZE] ;
+
+int nLanes ;     /* lanes of the group */
+int nActive ;    /* running lanes : 0 .. nActive-1 */
+int bReg [NO_REGS][BATCH_LANES] ;
+int bMem [DADDR_SIZE][BATCH_LANES] ;
+int bAddr [BATCH_LANES] ;
+int bCount [BATCH_LANES] ;  /* instructions of the lane, but bSteps */
+int bInput [BATCH_LANES] ;  /* input of the lane, in the group */
+int bSteps ;     /* instructions run by all running lanes at once */
+int bMinPc ;     /* lowest pc of the lanes, when they have parted */
+int bMaxCount ;  /* at least every bCount, for the fuel limit */
+int bJumps ;     /* backward jumps, to space out clock reads */
+double bDeadline ; /* end of the time limit of the group, 0 if none */
+long bParted ;   /* lane steps since the lanes parted */
+
+/* lanes parted for more lane steps than this do not
+   meet again soon (inputs of different sizes) : they
+   run one at a time to the end, on a TM of their own */
+#define   PARTED_STEPS  262144
+
+/* inputs of the group */
+STEPRESULT bResult [BATCH_LANES] ;
+int bExecuted [BATCH_LANES] ;
+FILE * bIn [BATCH_LANES] ;
+FILE * bOut [BATCH_LANES] ;
+
+/********************************************/
+double wallClock (void)
+{ struct timespec ts ;
+  clock_gettime(CLOCK_MONOTONIC, &ts) ;
+  return ts.tv_sec + ts.tv_nsec * 1e-9 ;
+} /* wallClock */
+
+/********************************************/
+/* decode the program for the lanes         */
+void decodeBatch (void)
+{ INSTRUCTION * i ;
+  DECODED * c ;
+  int pc, writesR ;
+
+  for (pc = 0 ; pc < IADDR_SIZE ; pc++)
+  { i = &machine.iMem[pc] ;
+    c = &bCode[pc] ;
+    c->op = i->iop ;
+    c->r = i->iarg1 ;
+    c->s = c->t = c->d = 0 ;
+    switch (opClass(i->iop))
+    { case opclRR : c->s = i->iarg2 ; c->t = i->iarg3 ; break ;
+      case opclRM :
+      case opclRA : c->d = i->iarg2 ; c->s = i->iarg3 ; break ;
+      case opclRB : c->s = i->iarg2 ; c->d = i->iarg3 + pc + 1 ; break ;
+      case opclRX : c->d = i->iarg2 ; c->s = i->iarg3 ; c->t = i->iarg4 ;
+                    break ;
+    }
+    writesR = (c->op != opHALT) && (c->op != opOUT) && (c->op != opST)
+              && (c->op != opSTX) && (c->op < opJLT || c->op > opJNE)
+              && (opClass(c->op) != opclRB) ;
+    c->setsPc = (opClass(c->op) == opclRB)
+                || ((c->op >= opJLT) && (c->op <= opJNE))
+                || (writesR && (c->r == PC_REG)) ;
+    c->pcUse = c->setsPc || (c->r == PC_REG) || (c->s == PC_REG)
+               || (c->t == PC_REG) ;
+  }
+} /* decodeBatch */
+
+/********************************************/
+/* stop lane l : the last running lane      */
+/* takes its place. a lane that halts has   */
+/* its pc past the HALT, as a TM has        */
+void stopLane ( int l, STEPRESULT result )
+{ int last = --nActive ;
+  int regNo, loc ;
+
+  if (result == srHALT)
+  { /* machine holds the program of the lanes */
+    machine.reg[PC_REG] = bReg[PC_REG][l] ;
+    writeHalt(bOut[bInput[l]], &machine) ;
+  }
+  bResult[bInput[l]] = result ;
+  bExecuted[bInput[l]] = bCount[l] + bSteps ;
+  if (l == last) return ;
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+    bReg[regNo][l] = bReg[regNo][last] ;
+  for (loc = 0 ; loc < machine.dSize ; loc++)
+    bMem[loc][l] = bMem[loc][last] ;
+  bCount[l] = bCount[last] ;
+  bInput[l] = bInput[last] ;
+} /* stopLane */
+
+/********************************************/
+/* stop all running lanes                   */
+void stopGroup ( STEPRESULT result )
+{ while (nActive > 0)
+    stopLane(nActive - 1, result) ;
+} /* stopGroup */
+
+/********************************************/
+/* the time limit of the group is checked   */
+/* every 1024 backward jumps, as tm_step    */
+/* checks the limit of a run                */
+int timeUp (void)
+{ return (bDeadline > 0) && ((++bJumps & 1023) == 0)
+         && (wallClock() >= bDeadline) ;
+} /* timeUp */
+
+/********************************************/
+/* a jump was taken by lane l at pc : the   */
+/* budget is checked as tm_step checks it.  */
+/* returns FALSE if the lane stopped        */
+int endJump ( int l, int pc )
+{ if ( (fuelLimit > 0) && (bCount[l] + bSteps >= fuelLimit) )
+  { stopLane(l, srFUEL) ;
+    return FALSE ;
+  }
+  if ( (bReg[PC_REG][l] <= pc) && timeUp() )
+  { stopGroup(srTIMEOUT) ;
+    return FALSE ;
+  }
+  return TRUE ;
+} /* endJump */
+
+/********************************************/
+/* scalar step of lane l, as tm_step.       */
+/* returns FALSE if the lane stopped, and   */
+/* lane l is now another lane               */
+int stepLane ( int l )
+{ DECODED * c ;
+  int pc, r, s, t, m = 0 ;
+
+  pc = bReg[PC_REG][l] ;
+  bCount[l]++ ;
+  if (bCount[l] > bMaxCount) bMaxCount = bCount[l] ;
+  if ( (pc < 0) || (pc >= IADDR_SIZE) )
+  { stopLane(l, srIMEM_ERR) ;
+    return FALSE ;
+  }
+  bReg[PC_REG][l] = pc + 1 ;
+  c = &bCode[pc] ;
+  r = c->r ;
+  s = c->s ;
+  t = c->t ;
+  switch (opClass(c->op))
+  { case opclRR : break ;
+    case opclRM :
+    case opclRA : m = c->d + bReg[s][l] ; break ;
+    case opclRB : m = c->d ; break ;
+    case opclRX : m = c->d + bReg[s][l] - bReg[t][l] ; break ;
+  }
+  if ( ((opClass(c->op) == opclRM) || (opClass(c->op) == opclRX))
+       && ((m < 0) || (m >= machine.dSize)) )
+  { stopLane(l, srDMEM_ERR) ;
+    return FALSE ;
+  }
+
+  switch (c->op)
+  { case opHALT :
+      stopLane(l, srHALT) ;
+      return FALSE ;
 
     case opIN :
-    /***********************************/
-      do
-      { printf("Enter value for IN instruction: ") ;
-        fflush (stdin);
-        fflush (stdout);
-        gets(in_Line);
-        lineLen = strlen(in_Line) ;
-        inCol = 0;
-        ok = getNum();
-        if ( ! ok ) printf ("Illegal value\n");
-        else reg[r] = num;
+      if ( fscanf(bIn[bInput[l]], "%d", &bReg[r][l]) != 1 )
+      { stopLane(l, srIN_EOF) ;
+        return FALSE ;
       }
-      while (! ok);
       break;
 
-    case opOUT :  
-      printf ("OUT instruction prints: %d\n", reg[r] ) ;
+    case opOUT :
+      fprintf (bOut[bInput[l]], "OUT instruction prints: %d\n", bReg[r][l] ) ;
       break;
-    case opADD :  reg[r] = reg[s] + reg[t] ;  break;
-    case opSUB :  reg[r] = reg[s] - reg[t] ;  break;
-    case opMUL :  reg[r] = reg[s] * reg[t] ;  break;
-
+    case opADD :  bReg[r][l] = bReg[s][l] + bReg[t][l] ;  break;
+    case opSUB :  bReg[r][l] = bReg[s][l] - bReg[t][l] ;  break;
+    case opMUL :  bReg[r][l] = bReg[s][l] * bReg[t][l] ;  break;
     case opDIV :
-    /***********************************/
-      if ( reg[t] != 0 ) reg[r] = reg[s] / reg[t];
-      else return srZERODIVIDE ;
+      if ( bReg[t][l] == 0 )
+      { stopLane(l, srZERODIVIDE) ;
+        return FALSE ;
+      }
+      bReg[r][l] = bReg[s][l] / bReg[t][l] ;
       break;
 
-    /*************** RM instructions ********************/
-    case opLD :    reg[r] = dMem[m] ;  break;
-    case opST :    dMem[m] = reg[r] ;  break;
-
-    /*************** RA instructions ********************/
-    case opLDA :    reg[r] = m ; break;
-    case opLDC :    reg[r] = currentinstruction.iarg2 ;   break;
-    case opJLT :    if ( reg[r] <  0 ) reg[PC_REG] = m ; break;
-    case opJLE :    if ( reg[r] <=  0 ) reg[PC_REG] = m ; break;
-    case opJGT :    if ( reg[r] >  0 ) reg[PC_REG] = m ; break;
-    case opJGE :    if ( reg[r] >=  0 ) reg[PC_REG] = m ; break;
-    case opJEQ :    if ( reg[r] == 0 ) reg[PC_REG] = m ; break;
-    case opJNE :    if ( reg[r] != 0 ) reg[PC_REG] = m ; break;
-
-    /* end of legal instructions */
+    case opLD :   bReg[r][l] = bMem[m][l] ;  break;
+    case opST :   bMem[m][l] = bReg[r][l] ;  break;
+
+    case opLDA :  bReg[r][l] = m ; break;
+    case opLDC :  bReg[r][l] = c->d ;   break;
+    case opMULI : bReg[r][l] = bReg[s][l] * c->d ; break;
+    case opDIVI :
+      if ( c->d == 0 )
+      { stopLane(l, srZERODIVIDE) ;
+        return FALSE ;
+      }
+      bReg[r][l] = bReg[s][l] / c->d ;
+      break;
+    case opJLT :  if ( bReg[r][l] <  0 ) bReg[PC_REG][l] = m ; break;
+    case opJLE :  if ( bReg[r][l] <= 0 ) bReg[PC_REG][l] = m ; break;
+    case opJGT :  if ( bReg[r][l] >  0 ) bReg[PC_REG][l] = m ; break;
+    case opJGE :  if ( bReg[r][l] >= 0 ) bReg[PC_REG][l] = m ; break;
+    case opJEQ :  if ( bReg[r][l] == 0 ) bReg[PC_REG][l] = m ; break;
+    case opJNE :  if ( bReg[r][l] != 0 ) bReg[PC_REG][l] = m ; break;
+
+    case opBLT :  if ( bReg[r][l] <  bReg[s][l] ) bReg[PC_REG][l] = m ; break;
+    case opBLE :  if ( bReg[r][l] <= bReg[s][l] ) bReg[PC_REG][l] = m ; break;
+    case opBGT :  if ( bReg[r][l] >  bReg[s][l] ) bReg[PC_REG][l] = m ; break;
+    case opBGE :  if ( bReg[r][l] >= bReg[s][l] ) bReg[PC_REG][l] = m ; break;
+    case opBEQ :  if ( bReg[r][l] == bReg[s][l] ) bReg[PC_REG][l] = m ; break;
+    case opBNE :  if ( bReg[r][l] != bReg[s][l] ) bReg[PC_REG][l] = m ; break;
+
+    case opLDX :  bReg[r][l] = bMem[m][l] ;  break;
+    case opSTX :  bMem[m][l] = bReg[r][l] ;  break;
   } /* case */
-  return srOKAY ;
-} /* stepTM */
+  if ( bReg[PC_REG][l] != pc + 1 )
+    return endJump(l, pc) ;
+  return TRUE ;
+} /* stepLane */
+
+/********************************************/
+/* lockstep run of the running lanes, all   */
+/* at pc, until they part or stop. returns  */
+/* -1, with the lowest pc in bMinPc if they */
+/* parted. an instruction that may stop a   */
+/* lane (IN, OUT, a fault) is stepped lane  */
+/* by lane.                                 */
+int runVector ( int pc )
+{ DECODED * c ;
+  int * P = bReg[PC_REG] ;
+  int * R, * S, * T ;
+  int l, n, d, next, same, bad, scalar ;
+
+  while (nActive > 0)
+  { if ( (pc < 0) || (pc >= IADDR_SIZE) )
+    { bSteps++ ;
+      stopGroup(srIMEM_ERR) ;
+      break ;
+    }
+    c = &bCode[pc] ;
+    n = nActive ;
+    R = bReg[c->r] ;
+    S = bReg[c->s] ;
+    T = bReg[c->t] ;
+    d = c->d ;
+    if (c->pcUse)
+      for (l = 0 ; l < n ; l++) P[l] = pc + 1 ;
+    bSteps++ ;
+    scalar = FALSE ;
+    bad = 0 ;
+    switch (c->op)
+    { case opHALT :
+        for (l = 0 ; l < n ; l++) P[l] = pc + 1 ;
+        stopGroup(srHALT) ;
+        break ;
+
+      case opADD : for (l = 0 ; l < n ; l++) R[l] = S[l] + T[l] ; break ;
+      case opSUB : for (l = 0 ; l < n ; l++) R[l] = S[l] - T[l] ; break ;
+      case opMUL : for (l = 0 ; l < n ; l++) R[l] = S[l] * T[l] ; break ;
+      case opDIV :
+        for (l = 0 ; l < n ; l++) bad |= (T[l] == 0) ;
+        if (bad) scalar = TRUE ;
+        else for (l = 0 ; l < n ; l++) R[l] = S[l] / T[l] ;
+        break ;
+
+      case opLD :
+      case opST :
+      case opLDX :
+      case opSTX :
+        if (opClass(c->op) == opclRM)
+          for (l = 0 ; l < n ; l++) bAddr[l] = d + S[l] ;
+        else
+          for (l = 0 ; l < n ; l++) bAddr[l] = d + S[l] - T[l] ;
+        for (l = 0 ; l < n ; l++)
+          bad |= ((unsigned) bAddr[l] >= (unsigned) machine.dSize) ;
+        if (bad) scalar = TRUE ;
+        else if ((c->op == opLD) || (c->op == opLDX))
+          for (l = 0 ; l < n ; l++) R[l] = bMem[bAddr[l]][l] ;
+        else
+          for (l = 0 ; l < n ; l++) bMem[bAddr[l]][l] = R[l] ;
+        break ;
+
+      case opLDA : for (l = 0 ; l < n ; l++) R[l] = d + S[l] ; break ;
+      case opLDC : for (l = 0 ; l < n ; l++) R[l] = d ; break ;
+      case opMULI : for (l = 0 ; l < n ; l++) R[l] = S[l] * d ; break ;
+      case opDIVI :
+        if (d == 0) scalar = TRUE ;
+        else for (l = 0 ; l < n ; l++) R[l] = S[l] / d ;
+        break ;
+
+      case opJLT :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] <  0) ? d + S[l] : P[l] ;
+        break ;
+      case opJLE :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] <= 0) ? d + S[l] : P[l] ;
+        break ;
+      case opJGT :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] >  0) ? d + S[l] : P[l] ;
+        break ;
+      case opJGE :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] >= 0) ? d + S[l] : P[l] ;
+        break ;
+      case opJEQ :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] == 0) ? d + S[l] : P[l] ;
+        break ;
+      case opJNE :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] != 0) ? d + S[l] : P[l] ;
+        break ;
+
+      case opBLT :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] <  S[l]) ? d : P[l] ;
+        break ;
+      case opBLE :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] <= S[l]) ? d : P[l] ;
+        break ;
+      case opBGT :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] >  S[l]) ? d : P[l] ;
+        break ;
+      case opBGE :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] >= S[l]) ? d : P[l] ;
+        break ;
+      case opBEQ :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] == S[l]) ? d : P[l] ;
+        break ;
+      case opBNE :
+        for (l = 0 ; l < n ; l++) P[l] = (R[l] != S[l]) ? d : P[l] ;
+        break ;
+
+      default :   /* IN, OUT */
+        scalar = TRUE ;
+        break ;
+    } /* case */
+
+    if (scalar)
+    { /* stepLane counts the step of each lane,
+         from its pc */
+      bSteps-- ;
+      for (l = 0 ; l < n ; l++) P[l] = pc ;
+      l = 0 ;
+      while (l < nActive)
+        if (stepLane(l)) l++ ;
+    }
+    if ( ! c->setsPc )
+    { pc++ ;
+      continue ;
+    }
+    if (nActive == 0) break ;
+
+    /* the next pc of every lane is in P */
+    n = nActive ;
+    next = P[0] ;
+    same = TRUE ;
+    for (l = 1 ; l < n ; l++) same &= (P[l] == next) ;
+    if ( ! same )
+    { /* the budget of the lanes that jumped */
+      l = 0 ;
+      while (l < nActive)
+        if ( scalar || (P[l] == pc + 1) || endJump(l, pc) ) l++ ;
+      n = nActive ;
+      bMinPc = P[0] ;
+      for (l = 1 ; l < n ; l++) bMinPc = (P[l] < bMinPc) ? P[l] : bMinPc ;
+      bParted = 0 ;
+      return -1 ;
+    }
+    if ( ! scalar && (next != pc + 1) )
+    { /* the budget of all lanes, which jumped */
+      if ( (fuelLimit > 0) && (bMaxCount + bSteps >= fuelLimit) )
+      { l = 0 ;
+        while (l < nActive)
+          if (bCount[l] + bSteps >= fuelLimit) stopLane(l, srFUEL) ;
+          else l++ ;
+      }
+      if ( (next <= pc) && timeUp() )
+        stopGroup(srTIMEOUT) ;
+    }
+    pc = next ;
+  }
+  return -1 ;
+} /* runVector */
+
+/********************************************/
+/* lanes at different pcs : the lanes at    */
+/* the lowest pc step first, so that lanes  */
+/* that parted after a branch meet again,   */
+/* and the next lowest pc is found on the   */
+/* way. a lane alone at the lowest pc runs  */
+/* on until it meets the others. a lane at  */
+/* a pc out of range stops. returns the pc  */
+/* of all lanes if they have met, or -1     */
+int stepParted (void)
+{ int * P = bReg[PC_REG] ;
+  int l = 0, low = 0, lowCount = 0, first = 0, same = TRUE ;
+  int next = IADDR_SIZE, second = IADDR_SIZE ;
+
+  while (l < nActive)
+  { if ( (P[l] < 0) || (P[l] >= IADDR_SIZE) )
+    { bCount[l]++ ;
+      stopLane(l, srIMEM_ERR) ;
+      continue ;
+    }
+    if (P[l] == bMinPc)
+    { bParted++ ;
+      if ( ! stepLane(l) ) continue ;
+    }
+    if (l == 0) first = P[0] ;
+    else if (P[l] != first) same = FALSE ;
+    if ( (P[l] >= 0) && (P[l] < next) )
+    { second = next ;
+      next = P[l] ;
+      low = l ;
+      lowCount = 1 ;
+    }
+    else if (P[l] == next) lowCount++ ;
+    else if ( (P[l] >= 0) && (P[l] < second) ) second = P[l] ;
+    l++ ;
+  }
+  if ( (nActive > 0) && same ) return first ;
+
+  /* the lane at the lowest pc is behind all others */
+  if (lowCount == 1)
+  { while ( (P[low] >= 0) && (P[low] < second) && stepLane(low) )
+      bParted++ ;
+    bMinPc = -1 ;   /* found on the next pass */
+    return -1 ;
+  }
+  bMinPc = next ;
+  return -1 ;
+} /* stepParted */
+
+/********************************************/
+/* run lane l alone to the end on the TM    */
+/* mc, as tm -r runs an input               */
+void runAlone ( TM_VM * mc, int l )
+{ STREAMS st ;
+  STEPRESULT result ;
+  long fuel ;
+  double seconds ;
+  int regNo, loc ;
+
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+    mc->reg[regNo] = bReg[regNo][l] ;
+  for (loc = 0 ; loc < machine.dSize ; loc++)
+    mc->dMem[loc] = bMem[loc][l] ;
+  st.in = bIn[bInput[l]] ;
+  st.out = bOut[bInput[l]] ;
+  mc->user = &st ;
+  /* the rest of the budget of the lane */
+  fuel = fuelLimit - (bCount[l] + bSteps) ;
+  seconds = bDeadline - wallClock() ;
+  tm_budget(mc, (fuelLimit > 0) ? ((fuel > 0) ? fuel : 1) : 0,
+            (bDeadline > 0) ? ((seconds > 0) ? seconds : 1e-9) : 0) ;
+  do
+  { result = tm_step(mc) ;
+    bCount[l]++ ;
+  }
+  while (result == srOKAY) ;
+  bReg[PC_REG][l] = mc->reg[PC_REG] ;
+  stopLane(l, result) ;
+} /* runAlone */
+
+/********************************************/
+/* run the program over input files, in     */
+/* groups of BATCH_LANES lanes              */
+void runBatch ( int nFiles, char * files[] )
+{ TM_VM * alone = (TM_VM *) malloc(sizeof(TM_VM)) ;
+  int first, k, l, loc, regNo, pc, c ;
+
+  *alone = machine ;     /* the loaded program and the hooks */
+  alone->memory = NULL ;
+  decodeBatch() ;
+  for (first = 0 ; first < nFiles ; first += BATCH_LANES)
+  { nLanes = nFiles - first ;
+    if (nLanes > BATCH_LANES) nLanes = BATCH_LANES ;
+
+    /* clear lanes, as the c(lear command does */
+    for (l = 0 ; l < nLanes ; l++)
+    { for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+        bReg[regNo][l] = 0 ;
+      bMem[0][l] = machine.dSize - 1 ;
+      for (loc = 1 ; loc < DADDR_SIZE ; loc++)
+        bMem[loc][l] = 0 ;
+      bCount[l] = 0 ;
+      bInput[l] = l ;
+      bResult[l] = srOKAY ;
+      bExecuted[l] = 0 ;
+      bOut[l] = tmpfile() ;
+      bIn[l] = fopen(files[first + l], "r") ;
+      if (bIn[l] == NULL)
+        fprintf(bOut[l], "file '%s' not found\n", files[first + l]) ;
+    }
+    nActive = nLanes ;
+    bSteps = 0 ;
+    bMaxCount = 0 ;
+    bJumps = 0 ;
+    bDeadline = (timeLimit > 0) ? wallClock() + timeLimit : 0 ;
+    l = 0 ;
+    while (l < nActive)
+      if (bIn[bInput[l]] == NULL) stopLane(l, srIN_EOF) ;
+      else l++ ;
+
+    pc = 0 ;
+    while (nActive > 0)
+      if (pc >= 0) pc = runVector(pc) ;
+      else if (bParted < PARTED_STEPS) pc = stepParted() ;
+      else runAlone(alone, 0) ;
+
+    for (k = 0 ; k < nLanes ; k++)
+    { printf("Input: %s\n", files[first + k]) ;
+      rewind(bOut[k]) ;
+      while ((c = getc(bOut[k])) != EOF) putchar(c) ;
+      printf("%s\n", stepResultTab[bResult[k]]) ;
+      printf("Number of instructions executed = %d\n", bExecuted[k]) ;
+      fclose(bOut[k]) ;
+      if (bIn[k] != NULL) fclose(bIn[k]) ;
+    }
+  }
+  free(alone) ;
+} /* runBatch */
+
+/********************************************/
+/* test-vector runner : the program runs    */
+/* over each input file on a pool of worker */
+/* threads. iMem is only read, and every    */
+/* worker has its own TM_VM.              */
+/********************************************/
+typedef struct {
+      char * name ;        /* input file */
+      STEPRESULT result ;
+      int count ;          /* instructions executed */
+   } RUNJOB;
+
+RUNJOB * jobs ;
+int nJobs ;
+int nextJob ;
+pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER ;
+
+/********************************************/
+void addJob ( char * name )
+{ static int size = 0 ;
+  if (nJobs == size)
+  { size = (size == 0) ? 64 : size * 2 ;
+    jobs = (RUNJOB *) realloc(jobs, size * sizeof(RUNJOB)) ;
+  }
+  jobs[nJobs].name = strdup(name) ;
+  jobs[nJobs].result = srOKAY ;
+  jobs[nJobs].count = 0 ;
+  nJobs++ ;
+} /* addJob */
+
+/********************************************/
+int compareJobs ( const void * a, const void * b )
+{ return strcmp(((RUNJOB *) a)->name, ((RUNJOB *) b)->name) ;
+} /* compareJobs */
+
+/********************************************/
+/* inputs are the files of a directory,     */
+/* except outputs (*.out), or the lines of  */
+/* a manifest file                          */
+int readJobs ( char * source )
+{ struct stat st ;
+  DIR * dir ;
+  struct dirent * entry ;
+  FILE * manifest ;
+  char path[4096] ;
+  int len ;
+
+  if (stat(source, &st) != 0)
+  { printf("file '%s' not found\n", source) ;
+    return FALSE ;
+  }
+  if (S_ISDIR(st.st_mode))
+  { if ((dir = opendir(source)) == NULL)
+    { printf("directory '%s' cannot be read\n", source) ;
+      return FALSE ;
+    }
+    while ((entry = readdir(dir)) != NULL)
+    { snprintf(path, sizeof(path), "%s/%s", source, entry->d_name) ;
+      len = strlen(entry->d_name) ;
+      if ((stat(path, &st) == 0) && S_ISREG(st.st_mode)
+          && ! ((len >= 4) && (strcmp(entry->d_name + len - 4, ".out") == 0)))
+        addJob(path) ;
+    }
+    closedir(dir) ;
+    qsort(jobs, nJobs, sizeof(RUNJOB), compareJobs) ;
+  }
+  else
+  { if ((manifest = fopen(source, "r")) == NULL)
+    { printf("file '%s' cannot be read\n", source) ;
+      return FALSE ;
+    }
+    while (fgets(path, sizeof(path), manifest) != NULL)
+    { len = strlen(path) ;
+      while ((len > 0) && isspace(path[len-1])) path[--len] = '\0' ;
+      if (len > 0) addJob(path) ;
+    }
+    fclose(manifest) ;
+  }
+  return TRUE ;
+} /* readJobs */
+
+/********************************************/
+/* run one input : output goes to <input>.out */
+void runJob ( TM_VM * mc, RUNJOB * job )
+{ STREAMS st ;
+  char * outName ;
+
+  tm_reset(mc) ;
+  mc->user = &st ;
+  job->count = 0 ;
+  st.in = fopen(job->name, "r") ;
+  if (st.in == NULL)
+  { job->result = srIN_EOF ;
+    return ;
+  }
+  outName = (char *) malloc(strlen(job->name) + 5) ;
+  strcpy(outName, job->name) ;
+  strcat(outName, ".out") ;
+  st.out = fopen(outName, "w") ;
+  free(outName) ;
+  if (st.out == NULL)
+  { fclose(st.in) ;
+    job->result = srIN_EOF ;
+    return ;
+  }
+
+  tm_budget(mc, fuelLimit, timeLimit) ;
+  do
+  { job->result = tm_step(mc) ;
+    job->count++ ;
+  }
+  while (job->result == srOKAY) ;
+  if (job->result == srHALT) writeHalt(st.out, mc) ;
+
+  fclose(st.in) ;
+  fclose(st.out) ;
+} /* runJob */
+
+/********************************************/
+void * runWorker ( void * arg )
+{ TM_VM * mc = (TM_VM *) malloc(sizeof(TM_VM)) ;
+  int job ;
+
+  *mc = machine ;        /* the loaded program and the hooks */
+  mc->memory = NULL ;
+
+  for (;;)
+  { pthread_mutex_lock(&jobLock) ;
+    job = nextJob++ ;
+    pthread_mutex_unlock(&jobLock) ;
+    if (job >= nJobs) break ;
+    runJob(mc, &jobs[job]) ;
+  }
+  free(mc) ;
+  return NULL ;
+} /* runWorker */
+
+/********************************************/
+/* run all inputs, then print the summary   */
+void runJobs ( char * source, int nThreads )
+{ pthread_t * workers ;
+  int counts[srTIMEOUT + 1] ;
+  long total = 0 ;
+  int i ;
+
+  if ( ! readJobs(source))
+    return ;
+  if (nThreads <= 0)
+    nThreads = (int) sysconf(_SC_NPROCESSORS_ONLN) ;
+  if (nThreads > nJobs)
+    nThreads = nJobs ;
+  if (nThreads <= 0)
+    nThreads = 1 ;
+
+  workers = (pthread_t *) malloc(nThreads * sizeof(pthread_t)) ;
+  for (i = 0 ; i < nThreads ; i++)
+    pthread_create(&workers[i], NULL, runWorker, NULL) ;
+  for (i = 0 ; i < nThreads ; i++)
+    pthread_join(workers[i], NULL) ;
+  free(workers) ;
+
+  for (i = 0 ; i <= srTIMEOUT ; i++)
+    counts[i] = 0 ;
+  for (i = 0 ; i < nJobs ; i++)
+  { printf("%s: %s, %d instructions\n",
+           jobs[i].name, stepResultTab[jobs[i].result], jobs[i].count) ;
+    counts[jobs[i].result]++ ;
+    total += jobs[i].count ;
+  }
+  printf("Inputs: %d, instructions: %ld\n", nJobs, total) ;
+  for (i = 0 ; i <= srTIMEOUT ; i++)
+    if (counts[i] > 0)
+      printf("   %s: %d\n", stepResultTab[i], counts[i]) ;
+} /* runJobs */
+
+/********************************************/
+/* fork server : the program is loaded once */
+/* and a UNIX socket is served. For every   */
+/* connection a child is forked, which has  */
+/* a copy-on-write copy of the loaded       */
+/* machine, reads the input from the        */
+/* connection until the client shuts down   */
+/* writing, and answers with the output,    */
+/* the step result and the instruction count */
+/********************************************/
+int openSocket ( char * path, struct sockaddr_un * addr )
+{ int fd = socket(AF_UNIX, SOCK_STREAM, 0) ;
+  if (fd < 0)
+  { perror("socket") ;
+    return -1 ;
+  }
+  memset(addr, 0, sizeof(struct sockaddr_un)) ;
+  addr->sun_family = AF_UNIX ;
+  if (strlen(path) >= sizeof(addr->sun_path))
+  { printf("socket name '%s' is too long\n", path) ;
+    close(fd) ;
+    return -1 ;
+  }
+  strcpy(addr->sun_path, path) ;
+  return fd ;
+} /* openSocket */
+
+/********************************************/
+void serveRun ( int conn )
+{ STEPRESULT result ;
+  STREAMS st ;
+  int count = 0 ;
+
+  st.in = fdopen(conn, "r") ;
+  st.out = fdopen(dup(conn), "w") ;
+  if ((st.in == NULL) || (st.out == NULL))
+    _exit(1) ;
+  machine.user = &st ;
+  tm_budget(&machine, fuelLimit, timeLimit) ;
+  do
+  { result = tm_step(&machine) ;
+    count++ ;
+  }
+  while (result == srOKAY) ;
+  if (result == srHALT) writeHalt(st.out, &machine) ;
+  fprintf(st.out, "%s\n", stepResultTab[result]) ;
+  fprintf(st.out, "Number of instructions executed = %d\n", count) ;
+  fclose(st.out) ;
+  fclose(st.in) ;
+  _exit(0) ;
+} /* serveRun */
+
+/********************************************/
+void runServer ( char * path )
+{ struct sockaddr_un addr ;
+  int fd, conn ;
+
+  if ((fd = openSocket(path, &addr)) < 0)
+    exit(1) ;
+  unlink(path) ;
+  if ((bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+      || (listen(fd, 64) < 0))
+  { perror(path) ;
+    exit(1) ;
+  }
+  signal(SIGCHLD, SIG_IGN) ; /* children are reaped automatically */
+  printf("TM  serving %s on %s\n", pgmName, path) ;
+  fflush(stdout) ;
+  for (;;)
+  { conn = accept(fd, NULL, NULL) ;
+    if (conn < 0) continue ;
+    switch (fork())
+    { case 0 :
+        close(fd) ;
+        serveRun(conn) ; /* does not return */
+        break ;
+      case -1 :
+        perror("fork") ;
+        close(conn) ;
+        break ;
+      default :
+        close(conn) ;
+        break ;
+    }
+  }
+} /* runServer */
+
+/********************************************/
+/* client of the fork server : sends stdin  */
+/* and copies the answer to stdout          */
+int runClient ( char * path )
+{ struct sockaddr_un addr ;
+  char buf[4096] ;
+  int fd, n ;
+
+  if ((fd = openSocket(path, &addr)) < 0)
+    return 1 ;
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+  { perror(path) ;
+    return 1 ;
+  }
+  while ((n = read(0, buf, sizeof(buf))) > 0)
+    if (write(fd, buf, n) != n)
+      break ;
+  shutdown(fd, SHUT_WR) ;
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    if (write(1, buf, n) != n)
+      break ;
+  close(fd) ;
+  return 0 ;
+} /* runClient */
+
+/********************************************/
+/* call-graph profile : calls are jumps     */
+/* made right after the return address was  */
+/* stored at mp-1, returns are jumps to     */
+/* that address + 1 which restore the fp of */
+/* the caller (the previous fp is kept at   */
+/* fp+1). Instructions are counted on a     */
+/* calling context tree.                    */
+/********************************************/
+typedef struct profnode {
+      int entry ;                  /* function entry, -1 at top level */
+      long self ;                  /* instructions executed here */
+      struct profnode * parent ;
+      struct profnode * child ;
+      struct profnode * sibling ;
+   } PROFNODE;
+
+typedef struct {
+      PROFNODE * node ;
+      int retAddr ;                /* location returned to */
+      int callerFp ;               /* fp restored by the return */
+      long start ;                 /* instruction count at the call */
+   } PROFFRAME;
+
+#define   PROF_DEPTH  DADDR_SIZE   /* frames are at least 3 words */
+
+PROFNODE * profRoot = NULL ;
+PROFNODE * profCur ;
+PROFFRAME profStack [PROF_DEPTH] ;
+int profTop ;
+long profCount ;
+long profCalls [IADDR_SIZE] ;
+long profIncl [IADDR_SIZE] ;
+long profExcl [IADDR_SIZE] ;
+int profActive [IADDR_SIZE] ;      /* activations, for recursion */
+long profInstr [IADDR_SIZE] ;      /* executions of each location */
+
+/********************************************/
+void freeProfNode ( PROFNODE * node )
+{ PROFNODE * next ;
+  while (node != NULL)
+  { freeProfNode(node->child) ;
+    next = node->sibling ;
+    free(node) ;
+    node = next ;
+  }
+} /* freeProfNode */
+
+/********************************************/
+void clearProfile (void)
+{ int loc ;
+  freeProfNode(profRoot) ;
+  profRoot = (PROFNODE *) calloc(1, sizeof(PROFNODE)) ;
+  profRoot->entry = -1 ;
+  profCur = profRoot ;
+  profTop = 0 ;
+  profCount = 0 ;
+  for (loc = 0 ; loc < IADDR_SIZE ; loc++)
+  { profCalls[loc] = 0 ;
+    profIncl[loc] = 0 ;
+    profExcl[loc] = 0 ;
+    profActive[loc] = 0 ;
+    profInstr[loc] = 0 ;
+  }
+} /* clearProfile */
+
+/********************************************/
+void profileReturn (void)
+{ PROFFRAME * frame = &profStack[--profTop] ;
+  int entry = frame->node->entry ;
+  if (--profActive[entry] == 0)
+    profIncl[entry] += profCount - frame->start ;
+  profCur = frame->node->parent ;
+} /* profileReturn */
+
+/********************************************/
+/* account the instruction just executed at */
+/* loc, then follow a call or return        */
+void profileStep ( int loc )
+{ int pc = machine.reg[PC_REG] ;
+  int mp = machine.reg[MP_REG] ;
+  PROFNODE * node ;
+  PROFFRAME * frame ;
+
+  profCount++ ;
+  profCur->self++ ;
+  profInstr[loc]++ ;
+  if (profCur->entry >= 0) profExcl[profCur->entry]++ ;
+  if ((pc == loc + 1) || (pc < 0) || (pc >= IADDR_SIZE))
+    return ;
+
+  if ((profTop > 0) && (pc == profStack[profTop-1].retAddr)
+      && (machine.reg[FP_REG] == profStack[profTop-1].callerFp))
+    profileReturn() ;
+  else if ((mp >= 1) && (mp <= DADDR_SIZE)
+           && (machine.dMem[mp-1] == loc) && (profTop < PROF_DEPTH))
+  { for (node = profCur->child ; node != NULL ; node = node->sibling)
+      if (node->entry == pc) break ;
+    if (node == NULL)
+    { node = (PROFNODE *) calloc(1, sizeof(PROFNODE)) ;
+      node->entry = pc ;
+      node->parent = profCur ;
+      node->sibling = profCur->child ;
+      profCur->child = node ;
+    }
+    frame = &profStack[profTop++] ;
+    frame->node = node ;
+    frame->retAddr = loc + 1 ;
+    frame->callerFp = machine.reg[FP_REG] ;
+    frame->start = profCount ;
+    profCalls[pc]++ ;
+    profActive[pc]++ ;
+    profCur = node ;
+  }
+} /* profileStep */
+
+/********************************************/
+void writeProfName ( FILE * f, int entry )
+{ if (entry < 0) fprintf(f, "(tm)") ;
+  else if (funcName[entry] != NULL) fprintf(f, "%s", funcName[entry]) ;
+  else fprintf(f, "func_%d", entry) ;
+} /* writeProfName */
+
+/********************************************/
+void writeFolded ( FILE * f, PROFNODE * node )
+{ PROFNODE * path [PROF_DEPTH + 1] ;
+  PROFNODE * n ;
+  int depth, i ;
+  for ( ; node != NULL ; node = node->sibling)
+  { if (node->self > 0)
+    { depth = 0 ;
+      for (n = node ; n != NULL ; n = n->parent)
+        path[depth++] = n ;
+      for (i = depth - 1 ; i >= 0 ; i--)
+      { writeProfName(f, path[i]->entry) ;
+        fprintf(f, (i > 0) ? ";" : " %ld\n", node->self) ;
+      }
+    }
+    writeFolded(f, node->child) ;
+  }
+} /* writeFolded */
+
+/********************************************/
+/* print the flat profile and write folded  */
+/* stacks for flame graph tools             */
+void writeProfile (void)
+{ char * foldName ;
+  FILE * f ;
+  int loc, line ;
+  long * lineCount ;
+
+  /* frames left by HALT or a fault count as returned */
+  while (profTop > 0)
+    profileReturn() ;
+
+  printf("%10s %12s %12s  %s\n", "calls", "inclusive", "exclusive",
+         "function") ;
+  printf("%10s %12ld %12ld  (tm)\n", "", profCount, profRoot->self) ;
+  for (loc = 0 ; loc < IADDR_SIZE ; loc++)
+    if (profCalls[loc] > 0)
+    { printf("%10ld %12ld %12ld  ", profCalls[loc], profIncl[loc],
+             profExcl[loc]) ;
+      writeProfName(stdout, loc) ;
+      printf("\n") ;
+    }
+
+  /* instructions by source line, from the line table */
+  if (maxSrcLine > 0)
+  { lineCount = (long *) calloc(maxSrcLine + 1, sizeof(long)) ;
+    for (loc = 0 ; loc < IADDR_SIZE ; loc++)
+      lineCount[srcLine[loc]] += profInstr[loc] ;
+    printf("%10s %12s\n", "line", "instructions") ;
+    for (line = 1 ; line <= maxSrcLine ; line++)
+      if (lineCount[line] > 0)
+        printf("%10d %12ld\n", line, lineCount[line]) ;
+    free(lineCount) ;
+  }
+
+  foldName = sideName(".folded") ;
+  if ((f = fopen(foldName, "w")) == NULL)
+  { printf("file '%s' cannot be written\n", foldName) ;
+    free(foldName) ;
+    return ;
+  }
+  writeFolded(f, profRoot) ;
+  fclose(f) ;
+  printf("Folded stacks written to %s\n", foldName) ;
+  free(foldName) ;
+} /* writeProfile */
+
+/********************************************/
+/* symbol map : lines of "location name"    */
+int readSymbolMap ( char * mapName )
+{ FILE * map = fopen(mapName, "r") ;
+  char name[LINESIZE] ;
+  int loc ;
+  if (map == NULL)
+  { printf("file '%s' not found\n", mapName) ;
+    return FALSE ;
+  }
+  while (fscanf(map, "%d %120s", &loc, name) == 2)
+    if ((loc >= 0) && (loc < IADDR_SIZE))
+    { free(funcName[loc]) ;
+      funcName[loc] = strdup(name) ;
+    }
+  fclose(map) ;
+  return TRUE ;
+} /* readSymbolMap */
+
+/********************************************/
+/* binary trace of a run : the changes made */
+/* by each step, in the format of tmtrace.h */
+/********************************************/
+FILE * traceFile ;
+int traceRegs [NO_REGS] ;  /* registers before the step */
+int traceStore ;           /* location stored to, or -1 */
+int traceOld ;             /* its value before the step */
+
+/********************************************/
+void putNumber ( unsigned long n )
+{ while (n >= 0x80)
+  { putc((int) (n & 0x7f) | 0x80, traceFile) ;
+    n >>= 7 ;
+  }
+  putc((int) n, traceFile) ;
+} /* putNumber */
+
+/********************************************/
+void putSigned ( long n )
+{ putNumber((n >= 0) ? 2 * (unsigned long) n : 2 * (unsigned long) (-n) - 1) ;
+} /* putSigned */
+
+/********************************************/
+/* memory hook while tracing : remembers    */
+/* the stored location, and passes on to    */
+/* the memory profile                       */
+void traceMemory ( TM_VM * vm, int pc, int addr, int store )
+{ if (store)
+  { traceStore = addr ;
+    traceOld = vm->dMem[addr] ;
+  }
+  if (memflag) memAccess(vm, pc, addr, store) ;
+} /* traceMemory */
+
+/********************************************/
+int traceStart (void)
+{ int loc, last, regNo ;
+  traceFile = fopen(traceName, "wb") ;
+  if (traceFile == NULL)
+  { printf("file '%s' cannot be written\n", traceName) ;
+    return FALSE ;
+  }
+  fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, traceFile) ;
+  for (last = IADDR_SIZE ; last > 0 ; last--)
+    if ((machine.iMem[last-1].iop != opHALT)
+        || (machine.iMem[last-1].iarg1 != 0)
+        || (machine.iMem[last-1].iarg2 != 0)
+        || (machine.iMem[last-1].iarg3 != 0))
+      break ;
+  putNumber(last) ;
+  for (loc = 0 ; loc < last ; loc++)
+  { putNumber(machine.iMem[loc].iop) ;
+    putSigned(machine.iMem[loc].iarg1) ;
+    putSigned(machine.iMem[loc].iarg2) ;
+    putSigned(machine.iMem[loc].iarg3) ;
+    putSigned(machine.iMem[loc].iarg4) ;
+  }
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+    putSigned(traceRegs[regNo] = machine.reg[regNo]) ;
+  for (loc = 0 ; loc < DADDR_SIZE ; loc++)
+    putSigned(machine.dMem[loc]) ;
+  machine.memory = traceMemory ;
+  traceStore = -1 ;
+  return TRUE ;
+} /* traceStart */
+
+/********************************************/
+/* the step at pc was executed : it changed */
+/* at most one register besides the pc      */
+void traceStep ( int pc )
+{ int regNo, changed = -1 ;
+  int tag = 0 ;
+  for (regNo = 0 ; regNo < PC_REG ; regNo++)
+    if (machine.reg[regNo] != traceRegs[regNo])
+      changed = regNo ;
+  if (changed >= 0) tag = TR_REG | changed ;
+  if ((traceStore >= 0) && (machine.dMem[traceStore] != traceOld))
+    tag |= TR_MEM ;
+  if (machine.reg[PC_REG] != pc + 1)
+    tag |= TR_JUMP ;
+  putc(tag, traceFile) ;
+  if (tag & TR_REG)
+  { putSigned((long) machine.reg[changed] - traceRegs[changed]) ;
+    traceRegs[changed] = machine.reg[changed] ;
+  }
+  if (tag & TR_MEM)
+  { putNumber(traceStore) ;
+    putSigned((long) machine.dMem[traceStore] - traceOld) ;
+  }
+  if (tag & TR_JUMP)
+    putNumber(machine.reg[PC_REG]) ;
+  traceStore = -1 ;
+} /* traceStep */
+
+/********************************************/
+void traceEnd ( STEPRESULT result )
+{ putc(TR_END, traceFile) ;
+  putNumber(result) ;
+  fclose(traceFile) ;
+  machine.memory = memflag ? memAccess : NULL ;
+  printf("Trace written to %s\n", traceName) ;
+} /* traceEnd */
 
 /********************************************/
 int doCommand (void)
 { char cmd;
   int stepcnt=0, i;
   int printcnt;
+  int sets, ways;
   int stepResult;
-  int regNo, loc;
   do
   { printf ("Enter command: ");
     fflush (stdin);
@@ -440,6 +1639,11 @@ int doCommand (void)
       printf("   p(rint         "\
              "Toggle print of total instructions executed"\
              " ('go' only)\n");
+      printf("   f(unctions     "\
+             "Toggle call-graph profile ('go' only)\n");
+      printf("   m(em <s w l>   "\
+             "Toggle memory profile, with a cache of s sets\n"\
+             "                  of w ways and l words per line ('go' only)\n");
       printf("   c(lear         "\
              "Reset simulator for new execution of program\n");
       printf("   h(elp          "\
@@ -455,6 +1659,35 @@ int doCommand (void)
       if ( icountflag ) printf("on.\n"); else printf("off.\n");
       break;
 
+    case 'm' :
+    /***********************************/
+      if ( atEOL ())
+        memflag = ! memflag ;
+      else if ( getNum () && ((sets = num) > 0)
+                && getNum () && ((ways = num) > 0) && (ways <= MAX_WAYS)
+                && getNum () && (num > 0) && atEOL () )
+      { cacheSets = sets ;
+        cacheWays = ways ;
+        cacheLine = num ;
+        memflag = TRUE ;
+      }
+      else
+      { printf("Cache sets, ways (at most %d) and line size?\n", MAX_WAYS) ;
+        break ;
+      }
+      clearMemProfile() ;
+      machine.memory = memflag ? memAccess : NULL ;
+      printf("Memory profile now ");
+      if ( memflag ) printf("on.\n"); else printf("off.\n");
+      break;
+
+    case 'f' :
+    /***********************************/
+      profileflag = ! profileflag ;
+      printf("Function profile now ");
+      if ( profileflag ) printf("on.\n"); else printf("off.\n");
+      break;
+
     case 's' :
     /***********************************/
       if ( atEOL ())  stepcnt = 1;
@@ -467,7 +1700,7 @@ int doCommand (void)
     case 'r' :
     /***********************************/
       for (i = 0; i < NO_REGS; i++)
-      { printf("%1d: %4d    ", i,reg[i]);
+      { printf("%1d: %4d    ", i,machine.reg[i]);
         if ( (i % 4) == 3 ) printf ("\n");
       }
       break;
@@ -503,7 +1736,7 @@ int doCommand (void)
       else
       { while ((dloc >= 0) && (dloc < DADDR_SIZE)
                   && (printcnt > 0))
-        { printf("%5d: %5d\n",dloc,dMem[dloc]);
+        { printf("%5d: %5d\n",dloc,machine.dMem[dloc]);
           dloc++;
           printcnt--;
         }
@@ -515,11 +1748,9 @@ int doCommand (void)
       iloc = 0;
       dloc = 0;
       stepcnt = 0;
-      for (regNo = 0;  regNo < NO_REGS ; regNo++)
-            reg[regNo] = 0 ;
-      dMem[0] = DADDR_SIZE - 1 ;
-      for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-            dMem[loc] = 0 ;
+      tm_reset(&machine) ;
+      clearProfile() ;
+      clearMemProfile() ;
       break;
 
     case 'q' : return FALSE;  /* break; */
@@ -528,24 +1759,36 @@ int doCommand (void)
   }  /* case */
   stepResult = srOKAY;
   if ( stepcnt > 0 )
-  { if ( cmd == 'g' )
+  { tm_budget(&machine, fuelLimit, timeLimit) ;
+    if ( cmd == 'g' )
     { stepcnt = 0;
+      if ( (traceName != NULL) && ! traceStart() )
+        return TRUE;
       while (stepResult == srOKAY)
-      { iloc = reg[PC_REG] ;
+      { iloc = machine.reg[PC_REG] ;
         if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
+        stepResult = tm_step (&machine);
+        if ( profileflag ) profileStep( iloc ) ;
+        if ( traceName != NULL ) traceStep( iloc ) ;
         stepcnt++;
       }
+      if ( traceName != NULL ) traceEnd( stepResult ) ;
+      if ( stepResult == srHALT ) writeHalt(stdout, &machine) ;
       if ( icountflag )
         printf("Number of instructions executed = %d\n",stepcnt);
+      if ( profileflag )
+        writeProfile() ;
+      if ( memflag )
+        writeMemProfile() ;
     }
     else
     { while ((stepcnt > 0) && (stepResult == srOKAY))
-      { iloc = reg[PC_REG] ;
+      { iloc = machine.reg[PC_REG] ;
         if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
+        stepResult = tm_step (&machine);
         stepcnt-- ;
       }
+      if ( stepResult == srHALT ) writeHalt(stdout, &machine) ;
     }
     printf( "%s\n",stepResultTab[stepResult] );
   }
@@ -558,22 +1801,93 @@ int doCommand (void)
 /********************************************/
 
 main( int argc, char * argv[] )
-{ if (argc != 2)
-  { printf("usage: %s <filename>\n",argv[0]);
-    exit(1);
+{ int mode = 0 ;  /* 'b'atch, 'r'unner, 's'erver, or 0 for read-eval-print */
+  int nThreads = 0 ;
+  char * cmdName = argv[0] ;
+  char * mapName = NULL ;
+  while ((argc > 1) && (argv[1][0] == '-'))
+  { if (strcmp(argv[1], "-b") == 0) mode = 'b' ;
+    else if (strcmp(argv[1], "-r") == 0) mode = 'r' ;
+    else if (strcmp(argv[1], "-s") == 0) mode = 's' ;
+    else if ((strcmp(argv[1], "-c") == 0) && (argc == 3))
+      return runClient(argv[2]) ;
+    else if ((strcmp(argv[1], "-m") == 0) && (argc > 2))
+    { mapName = argv[2] ;
+      profileflag = TRUE ;
+      argv++ ;
+      argc-- ;
+    }
+    else if ((strcmp(argv[1], "-x") == 0) && (argc > 2))
+    { traceName = argv[2] ;
+      argv++ ;
+      argc-- ;
+    }
+    else if ((strcmp(argv[1], "-f") == 0) && (argc > 2))
+    { fuelLimit = atol(argv[2]) ;
+      argv++ ;
+      argc-- ;
+    }
+    else if ((strcmp(argv[1], "-w") == 0) && (argc > 2))
+    { timeLimit = atof(argv[2]) ;
+      argv++ ;
+      argc-- ;
+    }
+    else if ((strcmp(argv[1], "-j") == 0) && (argc > 2))
+    { nThreads = atoi(argv[2]) ;
+      argv++ ;
+      argc-- ;
+    }
+    else argc = 0 ;
+    argv++ ;
+    argc-- ;
   }
-  strcpy(pgmName,argv[1]) ;
-  if (strchr (pgmName, '.') == NULL)
-     strcat(pgmName,".tm");
-  pgm = fopen(pgmName,"r");
-  if (pgm == NULL)
-  { printf("file '%s' not found\n",pgmName);
+  if ( ((mode == 0) && (argc != 2))
+       || ((mode == 'b') && (argc < 3))
+       || (((mode == 'r') || (mode == 's')) && (argc != 3)) )
+  { printf("usage: %s [-m <symbol map>] [-x <trace>] <filename>\n",cmdName);
+    printf("       %s -b <filename> <input files>\n",cmdName);
+    printf("       %s -r [-j threads] <filename> <directory or manifest>\n",
+           cmdName);
+    printf("       %s -s <filename> <socket>\n",cmdName);
+    printf("       %s -c <socket> < <input file>\n",cmdName);
+    printf("options -f <instructions> and -w <seconds> limit each run"
+           " (-w each group of %d inputs with -b)\n", BATCH_LANES);
     exit(1);
   }
+  pgmName = argv[1] ;
+  if ((strrchr(pgmName, '.') == NULL) ||
+      ((strrchr(pgmName, '/') != NULL) &&
+       (strrchr(pgmName, '.') < strrchr(pgmName, '/'))))
+  { int size = strlen(argv[1]) + 4 ;
+    pgmName = (char *) malloc(size) ;
+    snprintf(pgmName, size, "%s.tm", argv[1]) ;
+  }
 
   /* read the program */
+  terminal.in = NULL ;
+  terminal.out = stdout ;
+  machine.in = streamIn ;
+  machine.out = streamOut ;
+  machine.user = &terminal ;
+  machine.label = labelFunction ;
   if ( ! readInstructions ())
          exit(1) ;
+  readLineTable () ;
+  if ((mapName != NULL) && ! readSymbolMap (mapName))
+         exit(1) ;
+  /* run over input files without the read-eval-print loop */
+  if ( mode == 'b' )
+  { runBatch(argc - 2, argv + 2) ;
+    return 0;
+  }
+  if ( mode == 'r' )
+  { runJobs(argv[2], nThreads) ;
+    return 0;
+  }
+  if ( mode == 's' )
+    runServer(argv[2]) ;
+  clearProfile() ;
+  clearMemProfile() ;
   /* switch input file to terminal */
   /* reset( input ); */
   /* read-eval-print */
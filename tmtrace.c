@@ -0,0 +1,238 @@
+/****************************************************/
+/* File: tmtrace.c                                  */
+/* Replay and analysis of binary TM traces          */
+/* (written by tm -x <trace>)                       */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libtm.h"
+#include "tmtrace.h"
+
+#define   TOP_COUNT  10
+
+/******** vars ********/
+FILE * trace ;
+TM_VM machine ;            /* state of the replay */
+int nLocs ;                /* locations of the program */
+long step ;                /* steps replayed */
+int stepPc ;               /* pc of the last step */
+STEPRESULT result = srOKAY ;
+
+/* analysis */
+long opCount [opRXLim + 1] ;
+long pcCount [IADDR_SIZE] ;
+long storeCount [DADDR_SIZE] ;
+long jumps, stores ;
+
+/********************************************/
+int getNumber ( unsigned long * n )
+{ int c, shift = 0 ;
+  *n = 0 ;
+  do
+  { if ((c = getc(trace)) == EOF) return FALSE ;
+    *n |= (unsigned long) (c & 0x7f) << shift ;
+    shift += 7 ;
+  }
+  while (c & 0x80) ;
+  return TRUE ;
+} /* getNumber */
+
+/********************************************/
+int getSigned ( long * n )
+{ unsigned long u ;
+  if ( ! getNumber(&u)) return FALSE ;
+  *n = (u & 1) ? - (long) (u >> 1) - 1 : (long) (u >> 1) ;
+  return TRUE ;
+} /* getSigned */
+
+/********************************************/
+/* the program and the state at the start   */
+int readHeader (void)
+{ char magic[TRACE_MAGIC_LEN] ;
+  unsigned long u ;
+  long a1, a2, a3, a4 ;
+  long v ;
+  int loc, regNo ;
+
+  if ((fread(magic, 1, TRACE_MAGIC_LEN, trace) != TRACE_MAGIC_LEN)
+      || (memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0)
+      || ! getNumber(&u) || (u > IADDR_SIZE))
+    return FALSE ;
+  nLocs = (int) u ;
+  for (loc = 0 ; loc < nLocs ; loc++)
+  { if ( ! getNumber(&u) || (u >= opRXLim) || ! getSigned(&a1)
+         || ! getSigned(&a2) || ! getSigned(&a3) || ! getSigned(&a4))
+      return FALSE ;
+    machine.iMem[loc].iop = (int) u ;
+    machine.iMem[loc].iarg1 = (int) a1 ;
+    machine.iMem[loc].iarg2 = (int) a2 ;
+    machine.iMem[loc].iarg3 = (int) a3 ;
+    machine.iMem[loc].iarg4 = (int) a4 ;
+  }
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+  { if ( ! getSigned(&v)) return FALSE ;
+    machine.reg[regNo] = (int) v ;
+  }
+  for (loc = 0 ; loc < DADDR_SIZE ; loc++)
+  { if ( ! getSigned(&v)) return FALSE ;
+    machine.dMem[loc] = (int) v ;
+  }
+  return TRUE ;
+} /* readHeader */
+
+/********************************************/
+/* replay the next step : FALSE at the end  */
+/* of the run                               */
+int replayStep (void)
+{ int tag = getc(trace) ;
+  unsigned long u ;
+  long v ;
+  int pc = machine.reg[PC_REG] ;
+
+  if ((tag == EOF) || (tag & TR_END))
+  { if ((tag != EOF) && getNumber(&u) && (u <= srTIMEOUT))
+      result = (STEPRESULT) u ;
+    return FALSE ;
+  }
+  stepPc = pc ;
+  machine.reg[PC_REG] = pc + 1 ;
+  if (tag & TR_REG)
+  { if ( ! getSigned(&v)) return FALSE ;
+    machine.reg[tag & TR_REGMASK] += (int) v ;
+  }
+  if (tag & TR_MEM)
+  { if ( ! getNumber(&u) || (u >= DADDR_SIZE) || ! getSigned(&v))
+      return FALSE ;
+    machine.dMem[u] += (int) v ;
+    storeCount[u]++ ;
+    stores++ ;
+  }
+  if (tag & TR_JUMP)
+  { if ( ! getNumber(&u)) return FALSE ;
+    machine.reg[PC_REG] = (int) u ;
+    jumps++ ;
+  }
+  if ((pc >= 0) && (pc < IADDR_SIZE))
+  { pcCount[pc]++ ;
+    opCount[machine.iMem[pc].iop]++ ;
+  }
+  step++ ;
+  return TRUE ;
+} /* replayStep */
+
+/********************************************/
+void writeInstruction ( int loc )
+{ INSTRUCTION * i = &machine.iMem[loc] ;
+  printf("%5d: %6s%3d,", loc, opCodeTab[i->iop], i->iarg1) ;
+  switch ( opClass(i->iop) )
+  { case opclRR: printf("%1d,%1d", i->iarg2, i->iarg3) ; break ;
+    case opclRM:
+    case opclRA: printf("%3d(%1d)", i->iarg2, i->iarg3) ; break ;
+    case opclRB: printf("%1d,%3d", i->iarg2, i->iarg3) ; break ;
+    case opclRX: printf("%3d(%1d,%1d)", i->iarg2, i->iarg3, i->iarg4) ;
+                 break ;
+  }
+} /* writeInstruction */
+
+/********************************************/
+void writeState (void)
+{ int regNo, loc ;
+  printf("State after step %ld:\n", step) ;
+  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
+  { printf("%1d: %4d    ", regNo, machine.reg[regNo]) ;
+    if ((regNo % 4) == 3) printf("\n") ;
+  }
+  for (loc = 0 ; loc < DADDR_SIZE ; loc++)
+    if (machine.dMem[loc] != 0)
+      printf("%5d: %5d\n", loc, machine.dMem[loc]) ;
+} /* writeState */
+
+/********************************************/
+/* index of the largest of n counts, which  */
+/* is then cleared                          */
+int takeTop ( long * counts, int n )
+{ int i, top = 0 ;
+  for (i = 1 ; i < n ; i++)
+    if (counts[i] > counts[top]) top = i ;
+  return top ;
+} /* takeTop */
+
+/********************************************/
+void writeAnalysis (void)
+{ int op, i, top ;
+  printf("Steps: %ld, jumps taken: %ld, stores: %ld\n", step, jumps, stores) ;
+  printf("Result: %s\n", stepResultTab[result]) ;
+  printf("%12s  %s\n", "executed", "opcode") ;
+  for (op = 0 ; op < opRXLim ; op++)
+    if (opCount[op] > 0)
+      printf("%12ld  %s\n", opCount[op], opCodeTab[op]) ;
+  printf("%12s  %s\n", "executed", "hottest instructions") ;
+  for (i = 0 ; i < TOP_COUNT ; i++)
+  { top = takeTop(pcCount, IADDR_SIZE) ;
+    if (pcCount[top] == 0) break ;
+    printf("%12ld  ", pcCount[top]) ;
+    writeInstruction(top) ;
+    printf("\n") ;
+    pcCount[top] = 0 ;
+  }
+  printf("%12s  %s\n", "stores", "most written locations") ;
+  for (i = 0 ; i < TOP_COUNT ; i++)
+  { top = takeTop(storeCount, DADDR_SIZE) ;
+    if (storeCount[top] == 0) break ;
+    printf("%12ld  %d\n", storeCount[top], top) ;
+    storeCount[top] = 0 ;
+  }
+} /* writeAnalysis */
+
+/********************************************/
+/* E X E C U T I O N   B E G I N S   H E R E */
+/********************************************/
+
+int main( int argc, char * argv[] )
+{ long target = -1 ;       /* -s : state after this step */
+  long first = -1, count = 0 ; /* -l : steps listed */
+
+  if ((argc == 4) && (strcmp(argv[2], "-s") == 0))
+    target = atol(argv[3]) ;
+  else if ((argc >= 3) && (argc <= 5) && (strcmp(argv[2], "-l") == 0))
+  { first = (argc > 3) ? atol(argv[3]) : 0 ;
+    count = (argc > 4) ? atol(argv[4]) : -1 ;
+  }
+  else if (argc != 2)
+  { printf("usage: %s <trace>                  analyse the run\n", argv[0]) ;
+    printf("       %s <trace> -s <step>        state after the step\n",
+           argv[0]) ;
+    printf("       %s <trace> -l [from [n]]    list n steps\n", argv[0]) ;
+    exit(1) ;
+  }
+  trace = fopen(argv[1], "rb") ;
+  if (trace == NULL)
+  { printf("file '%s' not found\n", argv[1]) ;
+    exit(1) ;
+  }
+  if ( ! readHeader())
+  { printf("file '%s' is not a TM trace\n", argv[1]) ;
+    exit(1) ;
+  }
+
+  if (target >= 0)
+  { while ((step < target) && replayStep())
+      ;
+    writeState() ;
+    return 0 ;
+  }
+  while (replayStep())
+    if ((first >= 0) && (step > first) && ((count < 0) || (step <= first + count)))
+    { printf("%10ld ", step) ;
+      writeInstruction(stepPc) ;
+      printf("\n") ;
+    }
+  if (first < 0)
+    writeAnalysis() ;
+  else
+    printf("%s\n", stepResultTab[result]) ;
+  fclose(trace) ;
+  return 0 ;
+} /* main */
@@ -0,0 +1,36 @@
+/****************************************************/
+/* File: tmtrace.h                                  */
+/* Binary execution trace of the TM computer        */
+/****************************************************/
+
+#ifndef _TMTRACE_H_
+#define _TMTRACE_H_
+
+/* A trace file starts with TRACE_MAGIC and the state
+ * at the start of the run : the number of locations
+ * of the program and, for each, the opcode and the four
+ * arguments, then the registers, then the data memory.
+ * Every step follows as a tag byte and the changes
+ * made by its instruction :
+ *   TR_REG + register : the register changed by the
+ *                       difference that follows
+ *   TR_MEM            : the location that follows
+ *                       changed by the difference that
+ *                       follows
+ *   TR_JUMP           : the new pc follows, otherwise
+ *                       the pc is the next location
+ * The run ends with TR_END and its step result.
+ * Numbers are stored in 7-bit groups, low group first,
+ * with the high bit set on all groups but the last;
+ * signed numbers are stored as 2n or -2n-1.
+ */
+#define   TRACE_MAGIC  "TMTR1\n"
+#define   TRACE_MAGIC_LEN  6
+
+#define   TR_REGMASK  0x07
+#define   TR_REG      0x08
+#define   TR_MEM      0x10
+#define   TR_JUMP     0x20
+#define   TR_END      0x40
+
+#endif
@@ -9,13 +9,19 @@
 #include "globals.h"
 #include "util.h"
 #include "y.tab.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 void PrintOperator(TokenType op);
 
 /* Procedure printToken prints a token 
- * and its lexeme to the listing file
+ * and its lexeme, of length characters,
+ * to the listing file
  */
-void printToken( TokenType token, const char* tokenString )
+void printToken( TokenType token, const char* tokenString, int length )
 { switch (token)
   { case IF:
     case ELSE:
@@ -31,7 +37,7 @@ void printToken( TokenType token, const char* tokenString )
 //    case READ:
 //    case WRITE:
       fprintf(listing,
-         "reserved word: %s\n",tokenString);
+         "reserved word: %.*s\n",length,tokenString);
       break;
 	case ASSIGN: fprintf(listing,"=\n"); break;
 	case EQ: fprintf(listing,"==\n"); break;
@@ -55,99 +61,228 @@ void printToken( TokenType token, const char* tokenString )
     case ENDFILE: fprintf(listing,"EOF\n"); break;
     case NUM:
       fprintf(listing,
-          "NUM, val= %s\n",tokenString);
+          "NUM, val= %.*s\n",length,tokenString);
       break;
     case ID:
       fprintf(listing,
-          "ID, name= %s\n",tokenString);
+          "ID, name= %.*s\n",length,tokenString);
       break;
     case ERROR:
       fprintf(listing,
-          "ERROR: %s\n",tokenString);
+          "ERROR: %.*s\n",length,tokenString);
       break;
     default: /* should never happen */
       fprintf(listing,"Unknown token: %d\n",token);
   }
 }
 
+/* syntax tree nodes and identifier strings are
+ * allocated from an arena of large blocks, which
+ * freeArena releases at once after compilation
+ */
+#define ARENA_BLOCK 65536
+
+typedef struct arenaBlock
+   { struct arenaBlock * next;
+     size_t used;
+     size_t size;
+     double align; /* data follows, aligned as a double */
+   } ArenaBlock;
+
+static ArenaBlock * arena = NULL;
+
+/* Function arenaAlloc returns n bytes from the
+ * arena, or NULL if out of memory
+ */
+static void * arenaAlloc( size_t n )
+{ ArenaBlock * b = arena;
+  size_t size;
+  /* keep every allocation aligned for any type */
+  n = (n + sizeof(double) - 1) & ~(sizeof(double) - 1);
+  if (b == NULL || b->used + n > b->size)
+  { size = n > ARENA_BLOCK ? n : ARENA_BLOCK;
+    b = (ArenaBlock *) malloc(sizeof(ArenaBlock) + size);
+    if (b == NULL) return NULL;
+    b->next = arena;
+    b->used = 0;
+    b->size = size;
+    arena = b;
+  }
+  b->used += n;
+  return (char *) (b + 1) + b->used - n;
+}
+
+/* identifiers are interned : each name has one copy,
+ * in the arena after its record of the hash table
+ */
+#define INTERN_SIZE 4096
+
+typedef struct internRec
+   { struct internRec * next;
+     unsigned int hash;
+     int length;
+     NameIndex index; /* in treeNames */
+   } InternRec;
+
+static InternRec * internTable[INTERN_SIZE];
+
+/* the side table of names, and the nodes, of the
+ * syntax tree : both grow by doubling, and their
+ * first entry is unused, as index 0 is none
+ */
+char ** treeNames = NULL;
+static NameIndex nameCount = 1;
+static NameIndex nameCapacity = 1;
+
+TreeNode * treeNodes = NULL;
+static NodeIndex nodeCount = 1;
+static NodeIndex nodeCapacity = 1;
+
+/* Function internName returns the interned copy
+ * of the name of length characters at s, which
+ * stays valid up to freeArena
+ */
+char * internName(const char * s, int length)
+{ unsigned int h = 0;
+  int i;
+  InternRec * r;
+  char ** names;
+  for (i = 0; i < length; i++)
+    h = h * 31 + (unsigned char) s[i];
+  for (r = internTable[h % INTERN_SIZE]; r != NULL; r = r->next)
+    if (r->hash == h && r->length == length
+        && memcmp((char *) (r + 1), s, length) == 0)
+      return (char *) (r + 1);
+  if (nameCount == nameCapacity)
+  { names = (char **) realloc(treeNames,
+        2 * nameCapacity * sizeof(char *));
+    if (names==NULL)
+    { fprintf(listing,"Out of memory error at line %d\n",lineno);
+      return NULL;
+    }
+    treeNames = names;
+    nameCapacity *= 2;
+  }
+  r = (InternRec *) arenaAlloc(sizeof(InternRec) + length + 1);
+  if (r==NULL)
+  { fprintf(listing,"Out of memory error at line %d\n",lineno);
+    return NULL;
+  }
+  memcpy(r + 1, s, length);
+  ((char *) (r + 1))[length] = '\0';
+  r->hash = h;
+  r->length = length;
+  r->index = nameCount;
+  treeNames[nameCount++] = (char *) (r + 1);
+  r->next = internTable[h % INTERN_SIZE];
+  internTable[h % INTERN_SIZE] = r;
+  return (char *) (r + 1);
+}
+
+/* Function internString returns the interned copy
+ * of name s
+ */
+char * internString(char * s)
+{ return internName(s, strlen(s));
+}
+
+/* Function nameHash returns the hash of interned
+ * name s, computed once by internName
+ */
+unsigned int nameHash(char * s)
+{ return ((InternRec *) s - 1)->hash;
+}
+
+/* Function nameIndex returns the index in treeNames
+ * of interned name s
+ */
+NameIndex nameIndex(char * s)
+{ return ((InternRec *) s - 1)->index;
+}
+
+/* Procedure freeArena releases all syntax tree
+ * nodes and identifier strings
+ */
+void freeArena(void)
+{ ArenaBlock * b;
+  memset(internTable, 0, sizeof(internTable));
+  free(treeNames);
+  treeNames = NULL;
+  nameCount = nameCapacity = 1;
+  free(treeNodes);
+  treeNodes = NULL;
+  nodeCount = nodeCapacity = 1;
+  while (arena != NULL)
+  { b = arena->next;
+    free(arena);
+    arena = b;
+  }
+}
+
+/* Function newNode creates a new node of kind k
+ * at the end of treeNodes, and returns its index,
+ * or 0 if out of memory
+ */
+static NodeIndex newNode(NodeKind k)
+{ TreeNode * nodes;
+  TreeNode * t;
+  if (nodeCount == nodeCapacity)
+  { nodes = (TreeNode *) realloc(treeNodes,
+        2 * nodeCapacity * sizeof(TreeNode));
+    if (nodes==NULL)
+    { fprintf(listing,"Out of memory error at line %d\n",lineno);
+      return 0;
+    }
+    treeNodes = nodes;
+    nodeCapacity *= 2;
+  }
+  t = &treeNodes[nodeCount];
+  memset(t, 0, sizeof(TreeNode));
+  t->nodekind = k;
+  t->lineno = lineno;
+  return nodeCount++;
+}
+
 /*
  * create empty node.
  */
-TreeNode * newEmptyNode()
+NodeIndex newEmptyNode()
 { 
-	TreeNode * t = (TreeNode *) malloc(sizeof(TreeNode));
-	int i;
-  
-	if (t==NULL)
-		fprintf(listing,"Out of memory error at line %d\n",lineno);
-  	else {
-	 	for (i = 0; i < MAXCHILDREN; i++)
-			t->child[i] = NULL;
-
-		t->sibling = NULL;
-	 	t->nodekind = EmptyK;
-	  	t->lineno = lineno;
-  	}
-  	return t;
+	return newNode(EmptyK);
 }
 
 /* Function newDeclareNode creates a new declaration
  * node for syntax tree construction
  */
-TreeNode * newDeclareNode(StmtKind kind)
+NodeIndex newDeclareNode(StmtKind kind)
 { 
-	TreeNode * t = (TreeNode *) malloc(sizeof(TreeNode));
-	int i;
+	NodeIndex i = newNode(DeclareK);
   
-	if (t==NULL)
-		fprintf(listing,"Out of memory error at line %d\n",lineno);
-  	else {
-	 	for (i = 0; i < MAXCHILDREN; i++)
-			t->child[i] = NULL;
-
-		t->sibling = NULL;
-	 	t->nodekind = DeclareK;
-		t->kind.declaration = kind;
-	  	t->lineno = lineno;
-  	}
-  	return t;
+	if (i != 0)
+		treeNodes[i].kind.declaration = kind;
+  	return i;
 }
 
 /* Function newStmtNode creates a new statement
  * node for syntax tree construction
  */
-TreeNode * newStmtNode(StmtKind kind)
-{ TreeNode * t = (TreeNode *) malloc(sizeof(TreeNode));
-  int i;
-  if (t==NULL)
-    fprintf(listing,"Out of memory error at line %d\n",lineno);
-  else {
-    for (i=0;i<MAXCHILDREN;i++) t->child[i] = NULL;
-    t->sibling = NULL;
-    t->nodekind = StmtK;
-    t->kind.stmt = kind;
-    t->lineno = lineno;
-  }
-  return t;
+NodeIndex newStmtNode(StmtKind kind)
+{ NodeIndex i = newNode(StmtK);
+  if (i != 0)
+    treeNodes[i].kind.stmt = kind;
+  return i;
 }
 
 /* Function newExpNode creates a new expression 
  * node for syntax tree construction
  */
-TreeNode * newExpNode(ExpKind kind)
-{ TreeNode * t = (TreeNode *) malloc(sizeof(TreeNode));
-  int i;
-  if (t==NULL)
-    fprintf(listing,"Out of memory error at line %d\n",lineno);
-  else {
-    for (i=0;i<MAXCHILDREN;i++) t->child[i] = NULL;
-    t->sibling = NULL;
-    t->nodekind = ExpK;
-    t->kind.exp = kind;
-    t->lineno = lineno;
-    t->type = Void;
+NodeIndex newExpNode(ExpKind kind)
+{ NodeIndex i = newNode(ExpK);
+  if (i != 0)
+  { treeNodes[i].kind.exp = kind;
+    treeNodes[i].type = Void;
   }
-  return t;
+  return i;
 }
 
 /* Function copyString allocates and makes a new
@@ -158,7 +293,7 @@ char * copyString(char * s)
   char * t;
   if (s==NULL) return NULL;
   n = strlen(s)+1;
-  t = malloc(n);
+  t = arenaAlloc(n);
   if (t==NULL)
     fprintf(listing,"Out of memory error at line %d\n",lineno);
   else strcpy(t,s);
@@ -202,8 +337,8 @@ void printTree(TreeNode * tree)
 			switch (tree->kind.declaration)
 			{
 				case IdDec:
-					if (tree->child[1] != NULL
-							&& tree->child[1]->nodekind == StmtK)
+					if (NODE(tree->child[1]) != NULL
+							&& NODE(tree->child[1])->nodekind == StmtK)
 					{
 						fprintf(listing,"Function ");
 					}
@@ -212,7 +347,7 @@ void printTree(TreeNode * tree)
 						fprintf(listing, "Variable ");
 					}
 
-					fprintf(listing,"Declaration - ID : %s, type : ", tree->attr.name);
+					fprintf(listing,"Declaration - ID : %s, type : ", NAME(tree));
 
                     switch (tree->type)
                     {
@@ -239,7 +374,7 @@ void printTree(TreeNode * tree)
 					break;
 
 				case ParamDec:
-					fprintf(listing,"Param : %s, type ", tree->attr.name);
+					fprintf(listing,"Param : %s, type ", NAME(tree));
 
                     switch (tree->type)
                     {
@@ -306,7 +441,7 @@ void printTree(TreeNode * tree)
 		   			break;
 
 				case IdExp:
-		  			fprintf(listing,"Expression - ID : %s\n", tree->attr.name);
+		  			fprintf(listing,"Expression - ID : %s\n", NAME(tree));
 		  			break;
 
 				default:
@@ -330,13 +465,13 @@ void printTree(TreeNode * tree)
 			 * only one new-line character is allowed at once.
 			 * if there is no child anymore, set new line.
 			 */
-			if (tree->child[i] == NULL && isNewlined == FALSE)
+			if (NODE(tree->child[i]) == NULL && isNewlined == FALSE)
 			{
 				isNewlined = TRUE;
 				fprintf(listing,"\n");
 			}
 
-			if (tree->child[i] != NULL)
+			if (NODE(tree->child[i]) != NULL)
 			{
 				/* set new line character when new child comes. */
 				if (isNewlined == FALSE)
@@ -351,10 +486,10 @@ void printTree(TreeNode * tree)
 				UNINDENT;
 			}
 
-			printTree(tree->child[i]);
+			printTree(NODE(tree->child[i]));
 		}
 
-		tree = tree->sibling;
+		tree = NODE(tree->sibling);
   	}
 
   	UNINDENT;
@@ -416,7 +551,87 @@ void PrintOperator(TokenType op)
 	}
 }
 
+/* TRUE if sourceText was read into the heap,
+ * FALSE if it is mapped
+ */
+static int sourceRead = FALSE;
 
+/* Function readSource reads the source file fd,
+ * which cannot be mapped (a pipe or a device), into
+ * the heap as sourceText, and returns FALSE if it
+ * cannot be read
+ */
+static int readSource(int fd)
+{ char * text = NULL;
+  char * grown;
+  long capacity = 0;
+  ssize_t n;
+  sourceLength = 0;
+  do
+  { if (sourceLength == capacity)
+    { capacity = (capacity == 0) ? 65536 : 2 * capacity;
+      grown = (char *) realloc(text, capacity);
+      if (grown == NULL)
+      { free(text);
+        return FALSE;
+      }
+      text = grown;
+    }
+    n = read(fd, text + sourceLength, capacity - sourceLength);
+    if (n > 0)
+      sourceLength += n;
+  } while (n > 0 || (n < 0 && errno == EINTR));
+  if (n < 0)
+  { free(text);
+    sourceLength = 0;
+    return FALSE;
+  }
+  sourceText = text;
+  sourceRead = TRUE;
+  return TRUE;
+}
 
+/* Function mapSource maps the source file fileName
+ * into memory as sourceText, or reads it if it is
+ * not a regular file, and returns FALSE if it
+ * cannot be read. The scanners read it in place.
+ */
+int mapSource(const char * fileName)
+{ struct stat st;
+  void * text;
+  int fd, ok;
+  fd = open(fileName, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0)
+  { if (fd >= 0) close(fd);
+    return FALSE;
+  }
+  if (!S_ISREG(st.st_mode))
+  { ok = readSource(fd);
+    close(fd);
+    return ok;
+  }
+  sourceLength = st.st_size;
+  if (sourceLength == 0)
+  { close(fd);
+    sourceText = "";
+    return TRUE;
+  }
+  text = mmap(NULL, sourceLength, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED)
+    return FALSE;
+  madvise(text, sourceLength, MADV_SEQUENTIAL);
+  sourceText = (const char *) text;
+  return TRUE;
+}
 
-
+/* Procedure unmapSource releases sourceText */
+void unmapSource(void)
+{ if (sourceRead)
+    free((void *) sourceText);
+  else if (sourceLength > 0)
+    munmap((void *) sourceText, sourceLength);
+  sourceRead = FALSE;
+  sourceText = NULL;
+  sourceLength = 0;
+}
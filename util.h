@@ -11,33 +11,68 @@
 /* Procedure printToken prints a token 
  * and its lexeme to the listing file
  */
-void printToken( TokenType, const char* );
+void printToken( TokenType, const char*, int );
 
 /* Function newDeclareNode creates a new declaration
  * node for syntax tree construction
  */
-TreeNode * newDeclareNode(StmtKind);
+NodeIndex newDeclareNode(StmtKind);
 
 /* Function newStmtNode creates a new statement
  * node for syntax tree construction
  */
-TreeNode * newStmtNode(StmtKind);
+NodeIndex newStmtNode(StmtKind);
 
 /* Function newExpNode creates a new expression 
  * node for syntax tree construction
  */
-TreeNode * newExpNode(ExpKind);
+NodeIndex newExpNode(ExpKind);
 
 /*
  * create empty node.
  */
-TreeNode * newEmptyNode(void);
+NodeIndex newEmptyNode(void);
 
 /* Function copyString allocates and makes a new
  * copy of an existing string
  */
 char * copyString( char * );
 
+/* Function internString returns the interned copy
+ * of name s : equal names have the same copy
+ */
+char * internString( char * );
+
+/* Function internName returns the interned copy
+ * of the name of the given length at s, which need
+ * not end with a null character
+ */
+char * internName( const char *, int );
+
+/* Function nameHash returns the hash of an interned
+ * name, without reading the name
+ */
+unsigned int nameHash( char * );
+
+/* Function nameIndex returns the index in treeNames
+ * of an interned name, for TreeNode attr.name
+ */
+NameIndex nameIndex( char * );
+
+/* Procedure freeArena releases all syntax tree
+ * nodes and strings of copyString and internString
+ */
+void freeArena(void);
+
+/* Function mapSource maps the source file fileName
+ * into memory as sourceText, and returns FALSE if it
+ * cannot be read
+ */
+int mapSource( const char * );
+
+/* Procedure unmapSource releases sourceText */
+void unmapSource(void);
+
 /* procedure printTree prints a syntax tree to the 
  * listing file using indentation to indicate subtrees
  */
@@ -0,0 +1,652 @@
+/****************************************************/
+/* File: x86gen.c                                   */
+/* The code generator implementation                */
+/* for the C-Minus compiler                         */
+/* (generates GNU assembler for x86-64 Linux)       */
+/****************************************************/
+
+#include <stdarg.h>
+#include "globals.h"
+#include "symtab.h"
+#include "x86gen.h"
+
+/*
+ * size of a variable slot in bytes.
+ * integers and array references both take one slot.
+ */
+#define SLOT 8
+
+/*
+ * number of arguments passed in registers
+ * by the System V calling convention.
+ */
+#define MAX_REG_ARGS 6
+
+static char *argRegs[MAX_REG_ARGS]
+    = {"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9"};
+
+/*
+ * current symbol table, searching order.
+ */
+static struct SymbolTable *currentTable;
+static int order = 0;
+
+/*
+ * number of labels used so far.
+ */
+static int labelCount = 0;
+
+/*
+ * number of values pushed on the stack in current function,
+ * used to keep the stack aligned to 16 bytes at calls.
+ */
+static int pushDepth = 0;
+
+/* prototype for internal recursive code generator */
+static void xGen (TreeNode * tree);
+static void genExp( TreeNode * tree);
+
+/* Procedure emitX86 prints an instruction formatted
+ * by fmt, with comment c if TraceCode is TRUE
+ */
+static void emitX86( char * c, char * fmt, ...)
+{
+    va_list args;
+
+    fprintf(code, "\t");
+    va_start(args, fmt);
+    vfprintf(code, fmt, args);
+    va_end(args);
+
+    if (TraceCode && c != NULL) fprintf(code, "\t# %s", c);
+    fprintf(code, "\n");
+}
+
+/* Procedure emitLabel prints a local label */
+static void emitLabel( int label)
+{ fprintf(code, ".L%d:\n", label); }
+
+/* Procedure emitX86Comment prints a comment line */
+static void emitX86Comment( char * c)
+{ if (TraceCode) fprintf(code, "# %s\n", c); }
+
+/* Procedure push / pop keeps track of pushed values. */
+static void push( char * reg)
+{
+    emitX86("push value", "pushq %s", reg);
+    pushDepth++;
+}
+
+static void pop( char * reg)
+{
+    emitX86("pop value", "popq %s", reg);
+    pushDepth--;
+}
+
+/* Function isConstant returns TRUE if tree is a constant number */
+static int isConstant( TreeNode * tree)
+{
+    return (tree != NULL && tree->nodekind == ExpK
+            && tree->kind.exp == ConstExp);
+}
+
+/* Function isRelop returns TRUE if tree is a relational operation */
+static int isRelop( TreeNode * tree)
+{
+    return (tree != NULL && tree->nodekind == ExpK
+            && tree->kind.exp == OpExp
+            && (tree->attr.op == EQ || tree->attr.op == NE
+                || tree->attr.op == LT || tree->attr.op == GT
+                || tree->attr.op == LE || tree->attr.op == GE));
+}
+
+/* Function varAddress returns the address of a variable,
+ * or of element 'index' of an array which is not a parameter,
+ * in a buffer kept up to the next call.
+ * like TM code, arrays grow downward from element 0.
+ */
+static char * varAddress( BucketList var, int index)
+{
+    static char * buf = NULL;
+    static size_t size = 0;
+    size_t length = strlen(var->name) + 32;
+
+    if (length > size)
+    {
+        buf = (char *) realloc(buf, length);
+        size = length;
+    }
+
+    if (var->is_global == 1)
+    {
+        if (index == 0)
+            sprintf(buf, "cm_%s(%%rip)", var->name);
+        else
+            sprintf(buf, "cm_%s-%d(%%rip)", var->name, SLOT * index);
+    }
+    else
+    {
+        sprintf(buf, "%d(%%rbp)", -SLOT * (var->location + 1 + index));
+    }
+
+    return buf;
+}
+
+/* Procedure loadArray loads the address of element 0
+ * of an array into reg.
+ */
+static void loadArray( BucketList var, char * reg)
+{
+    char *addr;
+
+    addr = varAddress(var, 0);
+
+    /* parameter holds reference. */
+    if (var->is_param == 1)
+        emitX86("load reference", "movq %s, %s", addr, reg);
+    else
+        emitX86("load array address", "leaq %s, %s", addr, reg);
+}
+
+/* Function alignCall keeps the stack aligned to 16 bytes
+ * at a call, given the number of arguments still to be
+ * pushed on the stack. It returns 1 if a pad was pushed.
+ */
+static int alignCall( int stackArgs)
+{
+    if ((pushDepth + stackArgs) % 2 != 0)
+    {
+        emitX86("align stack", "subq $%d, %%rsp", SLOT);
+        return 1;
+    }
+    return 0;
+}
+
+/* Procedure genCall generates code for a function call */
+static void genCall( TreeNode * tree, BucketList var)
+{
+    TreeNode *param;
+    int nargs, stackArgs, pad, i;
+
+    /* builtin functions. */
+    if (var->location == -1)
+    {
+        if (strcmp(NAME(tree), "input") == 0)
+        {
+            pad = alignCall(0);
+            emitX86("read integer value", "call cmrt_input");
+        }
+        else
+        {
+            genExp(NODE(tree->child[0]));
+            emitX86(NULL, "movl %%eax, %%edi");
+            pad = alignCall(0);
+            emitX86("write integer value", "call cmrt_output");
+        }
+
+        if (pad)
+            emitX86(NULL, "addq $%d, %%rsp", SLOT);
+        return;
+    }
+
+    /* evaluate arguments from left to right onto the stack. */
+    emitX86Comment("putting arguments");
+    nargs = 0;
+    for (param = NODE(tree->child[0]); param != NULL; param = NODE(param->sibling))
+    {
+        genExp(param);
+        push("%rax");
+        nargs++;
+    }
+
+    /* copy arguments after the sixth in reverse order,
+       so that the seventh is on top of the stack. */
+    stackArgs = (nargs > MAX_REG_ARGS) ? nargs - MAX_REG_ARGS : 0;
+    pad = alignCall(stackArgs);
+    for (i = nargs - 1; i >= MAX_REG_ARGS; i--)
+    {
+        emitX86("stack argument", "pushq %d(%%rsp)",
+                SLOT * (nargs - 1 - i + pad + (nargs - 1 - i)));
+    }
+
+    /* load register arguments. */
+    for (i = 0; i < nargs && i < MAX_REG_ARGS; i++)
+    {
+        emitX86("register argument", "movq %d(%%rsp), %s",
+                SLOT * (nargs - 1 - i + pad + stackArgs), argRegs[i]);
+    }
+    emitX86Comment("argument put on stack");
+
+    emitX86("call function", "call cm_%s", NAME(tree));
+    emitX86("pop arguments", "addq $%d, %%rsp",
+            SLOT * (nargs + pad + stackArgs));
+    pushDepth -= nargs;
+}
+
+/* Procedure genOperands generates code for both operands
+ * of a binary operator : left value in eax, right value in ecx.
+ */
+static void genOperands( TreeNode * tree)
+{
+    /* constant right operand : no need to store on stack. */
+    if (isConstant(NODE(tree->child[1])))
+    {
+        genExp(NODE(tree->child[0]));
+        emitX86("ecx = constant", "movl $%d, %%ecx", NODE(tree->child[1])->attr.val);
+        return;
+    }
+
+    genExp(NODE(tree->child[1]));
+    push("%rax");
+    genExp(NODE(tree->child[0]));
+    pop("%rcx");
+}
+
+/* Procedure genAssign generates code for an assignment :
+ * left(child[0]) is var, right(child[1]) is expression.
+ */
+static void genAssign( TreeNode * tree)
+{
+    TreeNode *left = NODE(tree->child[0]);
+    TreeNode *index = NODE(left->child[0]);
+    BucketList var = st_lookup(currentTable, NAME(left));
+    char *addr;
+
+    /* get expression value from right. */
+    genExp(NODE(tree->child[1]));
+
+    /* C-Minus do not support pointer expression,
+       so array itself is left in blank. */
+    if (var->type == IntegerArray && index == NULL)
+    {
+        return;
+    }
+
+    /* plain variable. */
+    if (var->type != IntegerArray)
+    {
+        addr = varAddress(var, 0);
+        emitX86("store variable", "movl %%eax, %s", addr);
+    }
+    /* constant index : fold into offset. */
+    else if (isConstant(index) && var->is_param != 1)
+    {
+        addr = varAddress(var, index->attr.val);
+        emitX86("store element", "movl %%eax, %s", addr);
+    }
+    else
+    {
+        push("%rax");
+        genExp(index);
+        emitX86("rcx = -index", "movslq %%eax, %%rcx");
+        emitX86(NULL, "negq %%rcx");
+        loadArray(var, "%rdx");
+        pop("%rax");
+        emitX86("store element", "movl %%eax, (%%rdx,%%rcx,%d)", SLOT);
+    }
+}
+
+/* Procedure genCondition generates code for the condition of
+ * a selection or iteration statement, jumping to label
+ * falseLabel if the condition is false.
+ * as in TM code, a plain value is true if it is 0.
+ */
+static void genCondition( TreeNode * tree, int falseLabel)
+{
+    char * jump;
+
+    if (isRelop(tree))
+    {
+        genOperands(tree);
+        emitX86("compare eax, ecx", "cmpl %%ecx, %%eax");
+
+        switch (tree->attr.op)
+        {
+            case EQ: jump = "jne"; break;
+            case NE: jump = "je";  break;
+            case LT: jump = "jge"; break;
+            case GT: jump = "jle"; break;
+            case LE: jump = "jg";  break;
+            default: jump = "jl";  break;
+        }
+    }
+    else
+    {
+        genExp(tree);
+        emitX86(NULL, "testl %%eax, %%eax");
+        jump = "jne";
+    }
+
+    emitX86("jump if condition is false", "%s .L%d", jump, falseLabel);
+}
+
+/* Function countSlots returns the number of slots
+ * needed for parameters and local variables of tree
+ */
+static int countSlots( TreeNode * tree)
+{
+    int slots = 0;
+    int i;
+
+    for (; tree != NULL; tree = NODE(tree->sibling))
+    {
+        if (tree->nodekind == DeclareK)
+        {
+            if (tree->kind.declaration == ParamDec)
+                slots += 1;
+            else if (tree->kind.declaration == IdDec)
+                slots += (tree->type == IntegerArray)
+                            ? NODE(tree->child[0])->attr.val : 1;
+        }
+        else
+        {
+            for (i = 0; i < MAXCHILDREN; i++)
+                slots += countSlots(NODE(tree->child[i]));
+        }
+    }
+
+    return slots;
+}
+
+/* Procedure genDeclare generates code at a declaration node */
+static void genDeclare( TreeNode * tree)
+{
+    struct SymbolTable *functionTable;
+    TreeNode *param;
+    BucketList node;
+    char *addr;
+    int frame, size, i;
+
+    /* parameters are spilled by the function prologue,
+       and local variables live in the frame. */
+    if (tree->kind.declaration != IdDec)
+        return;
+
+    /* function */
+    if (NODE(tree->child[1]) != NULL && NODE(tree->child[1])->nodekind == StmtK)
+    {
+        /* find table for parameters. */
+        functionTable = currentTable->child;
+        while (functionTable->functionName != NAME(tree))
+        {
+            functionTable = functionTable->sibling;
+        }
+
+        /* frame size, aligned to 16 bytes. */
+        frame = SLOT * (countSlots(NODE(tree->child[0])) + countSlots(NODE(tree->child[1])));
+        frame = (frame + 15) / 16 * 16;
+
+        fprintf(code, "\n\t.globl cm_%s\n", NAME(tree));
+        fprintf(code, "\t.type cm_%s, @function\n", NAME(tree));
+        fprintf(code, "cm_%s:\n", NAME(tree));
+
+        emitX86("store previous frame pointer", "pushq %%rbp");
+        emitX86("set frame pointer", "movq %%rsp, %%rbp");
+        if (frame > 0)
+            emitX86("allocate local variables", "subq $%d, %%rsp", frame);
+
+        /* spill parameters to their slots. */
+        for (i = 0, param = NODE(tree->child[0]); param != NULL;
+                i++, param = NODE(param->sibling))
+        {
+            node = table_lookup(functionTable->hashTable, NAME(param));
+            addr = varAddress(node, 0);
+
+            if (i < MAX_REG_ARGS)
+            {
+                emitX86("store parameter", "movq %s, %s", argRegs[i], addr);
+            }
+            else
+            {
+                emitX86("load stack parameter", "movq %d(%%rbp), %%rax",
+                        16 + SLOT * (i - MAX_REG_ARGS));
+                emitX86("store parameter", "movq %%rax, %s", addr);
+            }
+        }
+
+        /* generate code of current function. */
+        pushDepth = 0;
+        xGen(NODE(tree->child[1]));
+
+        /* return value is already in eax. */
+        emitX86Comment("Return Statements.");
+        emitX86(NULL, "leave");
+        emitX86(NULL, "ret");
+        fprintf(code, "\t.size cm_%s, .-cm_%s\n", NAME(tree), NAME(tree));
+    }
+    /* global variable : arrays grow downward from the label. */
+    else if (currentTable == globalTable)
+    {
+        size = (tree->type == IntegerArray) ? NODE(tree->child[0])->attr.val : 1;
+
+        fprintf(code, "\n\t.bss\n\t.align %d\n", SLOT);
+        if (size > 1)
+            fprintf(code, "\t.zero %d\n", SLOT * (size - 1));
+        fprintf(code, "cm_%s:\n\t.zero %d\n\t.text\n", NAME(tree), SLOT);
+    }
+}
+
+/* Procedure genStmt generates code at a statement node */
+static void genStmt( TreeNode * tree)
+{
+    int firstLabel, secondLabel;
+
+    switch(tree->kind.stmt)
+    {
+        case CompoundStmt:
+            /* set currentTable to next table. */
+            order += 1;
+            currentTable = findNewTableInOrder(globalTable, order);
+
+            /* local variables already have their slots in the frame. */
+            xGen(NODE(tree->child[1]));
+
+            /* restore table. */
+            currentTable = currentTable->parent;
+            break;
+
+        case SelectionStmt:
+            firstLabel = labelCount++;
+            genCondition(NODE(tree->child[0]), firstLabel);
+
+            xGen(NODE(tree->child[1]));
+
+            if (NODE(tree->child[2]) != NULL && NODE(tree->child[2])->nodekind != EmptyK)
+            {
+                secondLabel = labelCount++;
+                emitX86("jump to nonconditional area", "jmp .L%d", secondLabel);
+                emitLabel(firstLabel);
+                xGen(NODE(tree->child[2]));
+                emitLabel(secondLabel);
+            }
+            else
+            {
+                emitLabel(firstLabel);
+            }
+            break;
+
+        case IterationStmt:
+            firstLabel = labelCount++;
+            secondLabel = labelCount++;
+
+            emitLabel(firstLabel);
+            genCondition(NODE(tree->child[0]), secondLabel);
+            xGen(NODE(tree->child[1]));
+            emitX86("loop", "jmp .L%d", firstLabel);
+            emitLabel(secondLabel);
+            break;
+
+        /* as in TM code, returned value is left in eax
+           and the function ends at its last statement. */
+        case ReturnStmt:
+            if (NODE(tree->child[0]) != NULL)
+                genExp(NODE(tree->child[0]));
+            break;
+
+        default:
+            /* unknown node error */
+            break;
+    }
+}
+
+/* Procedure genExp generates code at an expression node,
+ * leaving the value in eax (array references in rax)
+ */
+static void genExp( TreeNode * tree)
+{
+    BucketList var;
+    char *addr;
+    char * set;
+    int label;
+
+    switch(tree->kind.exp)
+    {
+        case OpExp:
+            if (tree->attr.op == ASSIGN)
+            {
+                genAssign(tree);
+                break;
+            }
+
+            /* left value to eax, right value to ecx. */
+            genOperands(tree);
+
+            /* relational values are 0 if true, as in TM code. */
+            set = NULL;
+            switch(tree->attr.op)
+            {
+                case PLUS:
+                    emitX86("eax = eax + ecx", "addl %%ecx, %%eax");
+                    break;
+
+                case MINUS:
+                case EQ:
+                    emitX86("eax = eax - ecx", "subl %%ecx, %%eax");
+                    break;
+
+                case TIMES:
+                    emitX86("eax = eax * ecx", "imull %%ecx, %%eax");
+                    break;
+
+                case OVER:
+                    label = labelCount++;
+                    emitX86(NULL, "testl %%ecx, %%ecx");
+                    emitX86(NULL, "jne .L%d", label);
+                    alignCall(0);
+                    emitX86("division by 0", "call cmrt_zerodivide");
+                    emitLabel(label);
+                    emitX86(NULL, "cltd");
+                    emitX86("eax = eax / ecx", "idivl %%ecx");
+                    break;
+
+                case NE: set = "sete";  break;
+                case LT: set = "setge"; break;
+                case GT: set = "setle"; break;
+                case LE: set = "setg";  break;
+                case GE: set = "setl";  break;
+            }
+
+            if (set != NULL)
+            {
+                emitX86("compare eax, ecx", "cmpl %%ecx, %%eax");
+                emitX86("eax = 0 : true", "%s %%al", set);
+                emitX86(NULL, "movzbl %%al, %%eax");
+            }
+            break;
+
+        case ConstExp:
+            emitX86("load constant value", "movl $%d, %%eax", tree->attr.val);
+            break;
+
+        case IdExp:
+            var = st_lookup(currentTable, NAME(tree));
+
+            if (var->is_function == 1)
+            {
+                genCall(tree, var);
+            }
+            /* array itself : return reference. */
+            else if (var->type == IntegerArray && NODE(tree->child[0]) == NULL)
+            {
+                loadArray(var, "%rax");
+            }
+            /* array element. */
+            else if (var->type == IntegerArray)
+            {
+                /* constant index : fold into offset. */
+                if (isConstant(NODE(tree->child[0])) && var->is_param != 1)
+                {
+                    addr = varAddress(var, NODE(tree->child[0])->attr.val);
+                    emitX86("load element", "movl %s, %%eax", addr);
+                }
+                else
+                {
+                    genExp(NODE(tree->child[0]));
+                    emitX86("rcx = -index", "movslq %%eax, %%rcx");
+                    emitX86(NULL, "negq %%rcx");
+                    loadArray(var, "%rdx");
+                    emitX86("load element", "movl (%%rdx,%%rcx,%d), %%eax", SLOT);
+                }
+            }
+            /* normal variable. */
+            else
+            {
+                addr = varAddress(var, 0);
+                emitX86("load variable", "movl %s, %%eax", addr);
+            }
+            break;
+
+        default:
+            /* unknown node error */
+            break;
+    }
+}
+
+/* Procedure xGen recursively generates code by
+ * tree traversal
+ */
+static void xGen( TreeNode * tree)
+{
+    while (tree != NULL)
+    {
+        switch (tree->nodekind)
+        {
+            case DeclareK:
+                genDeclare(tree);
+                break;
+
+            case StmtK:
+                genStmt(tree);
+                break;
+
+            case ExpK:
+                genExp(tree);
+                break;
+
+            default:
+                break;
+        }
+
+        tree = NODE(tree->sibling);
+    }
+}
+
+/**********************************************/
+/* the primary function of the code generator */
+/**********************************************/
+/* Procedure x86Gen generates GNU assembler code for
+ * x86-64 Linux to the code file by traversal of the
+ * syntax tree.
+ */
+void x86Gen(TreeNode * syntaxTree, char * codefile)
+{
+    currentTable = globalTable;
+
+    fprintf(code, "# C-Minus Compilation to x86-64 Code\n");
+    fprintf(code, "# File: %s\n", codefile);
+    fprintf(code, "\t.text\n");
+
+    xGen(syntaxTree);
+
+    fprintf(code, "\n\t.section .note.GNU-stack,\"\",@progbits\n");
+}
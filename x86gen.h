@@ -0,0 +1,19 @@
+/****************************************************/
+/* File: x86gen.h                                   */
+/* The x86-64 code generator interface              */
+/* for the C-Minus compiler                         */
+/****************************************************/
+
+#ifndef _X86GEN_H_
+#define _X86GEN_H_
+
+/* Procedure x86Gen generates GNU assembler code for
+ * x86-64 Linux to the code file by traversal of the
+ * syntax tree. The second parameter (codefile) is the
+ * file name of the code file, and is used to print the
+ * file name as a comment in the code file.
+ * The output is linked with the runtime in x86rt.c.
+ */
+void x86Gen(TreeNode * syntaxTree, char * codefile);
+
+#endif
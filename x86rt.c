@@ -0,0 +1,58 @@
+/****************************************************/
+/* File: x86rt.c                                    */
+/* Runtime for C-Minus programs compiled to x86-64  */
+/* link with the assembler output of x86gen.c :     */
+/*     gcc prog.s x86rt.c -o prog                   */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* entry point of the C-Minus program */
+void cm_main(void);
+
+/* builtin function input reads an integer value */
+int cmrt_input(void)
+{
+    int value;
+    int c;
+
+    while (scanf("%d", &value) != 1)
+    {
+        if (feof(stdin))
+        {
+            fprintf(stderr, "input : end of file\n");
+            exit(1);
+        }
+
+        /* skip the illegal line, as TM does. */
+        fprintf(stderr, "Illegal value\n");
+        while ((c = getchar()) != '\n' && c != EOF)
+            ;
+    }
+
+    return value;
+}
+
+/* builtin function output writes an integer value.
+ * the value is returned, as TM leaves it in ac.
+ */
+int cmrt_output(int value)
+{
+    printf("%d\n", value);
+    return value;
+}
+
+/* division by 0 stops the program, as TM does. */
+void cmrt_zerodivide(void)
+{
+    fflush(stdout);
+    fprintf(stderr, "Division by 0\n");
+    exit(1);
+}
+
+int main(void)
+{
+    cm_main();
+    return 0;
+}